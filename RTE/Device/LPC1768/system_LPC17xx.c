@@ -301,8 +301,8 @@
 #define PLL1CFG_Val           0x00000023
 #define CCLKCFG_Val           0x00000003
 #define USBCLKCFG_Val         0x00000000
-#define PCLKSEL0_Val          0x00000000
-#define PCLKSEL1_Val          0x00000000
+#define PCLKSEL0_Val          0x00000154
+#define PCLKSEL1_Val          0x00050000
 #define PCONP_Val             0x042887DE
 #define CLKOUTCFG_Val         0x00000000
 
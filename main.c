@@ -1,636 +1,2376 @@
-/*
- * Default main.c for rtos lab.
- * @author Andrew Morton, 2018
- */
-#include <LPC17xx.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-#include "types.c"
-
-#define STACK_SIZE	1024
-#define NUM_PRIORITIES 5
-
-#define __PRIO
-
-volatile uint32_t msTicks = 0;
-
-int num_tasks = 0;
-TCB_t TASKS[6];
-int SWITCH = 0;
-TCB_t *currentTask, *readyTask;
-uint32_t stackPointer_current, stackPointer_next;
-bitVector_t bitVector = 0;
-queue_t priorityArray[NUM_PRIORITIES];
-
-int fpp_count[] = {0,5,2,5,2,5};
-int sem_count = 10;
-
-int contextFlag = 0;
-
-void Delay(uint32_t dlyTicks)
-{
-	uint32_t curTicks;
-	curTicks = msTicks;
-	
-	while((msTicks - curTicks) < dlyTicks);
-}
-
-void prioInherit()
-{
-	currentTask -> oldPriority = currentTask -> priority;
-	currentTask -> priority = HIGH;
-}
-
-void prioRestore()
-{
-	currentTask -> priority = currentTask -> oldPriority;
-}
-
-void queue_init(queue_t *q)
-{
-	q -> head = NULL;
-	q -> size = 0;
-}
-
-void enqueue(queue_t *q, TCB_t *t)
-{
-	TCB_t *curr = q -> head;
-	if (q -> size == 0)
-	{
-		q -> head = t;
-	}
-	else
-	{
-		while(curr -> next != NULL)
-		{
-			curr = curr -> next;
-		}
-		curr -> next = t;
-	}
-	q -> size++;
-	t->next = NULL;				// after enqueuing, the added TCB's next pointer should be NULL
-	t->state = READY;
-	bitVector |= 1 << t->priority;
-}
-TCB_t* dequeue(queue_t *q)
-{
-	TCB_t *curr = q -> head;
-	TCB_t *ret = curr;
-	
-	if (q -> size > 0)
-	{
-		q->head = curr->next;
-		q->size --;
-	}
-	if(q->size == 0)
-	{
-		bitVector &= ~(1 << curr->priority);
-	}
-	return ret;
-}
-
-void init_sem(sem_t *sem, uint32_t count)
-{
-	sem -> s = count;
-	queue_init(&(sem -> wait));
-	
-}
-void wait_sem(sem_t *sem)
-{
-	__disable_irq();
-	(sem -> s)--;
-	printf("\nt%d req", currentTask -> task_id);
-	if (sem -> s < 0)
-	{
-		currentTask -> state = BLOCKED;
-		enqueue(&sem -> wait,currentTask);
-		printf("\nt%d wait", currentTask -> task_id);
-		contextFlag = 1;
-	}
-	__enable_irq();
-	
-	while(contextFlag);
-}
-void signal_sem(sem_t *sem)
-{
-	__disable_irq();
-	(sem -> s)++;
-	if (sem -> s >= 0)
-	{
-		printf("\nt%d rel",currentTask -> task_id);
-		TCB_t *next = dequeue(&sem -> wait);
-		next -> state = READY;
-		enqueue(&priorityArray[next -> priority],&TASKS[next->task_id]);
-		contextFlag = 0;
-	}
-	__enable_irq();
-}
-
-void init_mtx(mutex_t *mtx)
-{
-	init_sem(&mtx -> m,1);
-}
-void acquire(mutex_t *mtx)
-{
-	__disable_irq();
-	if (mtx -> m.s == 0)
-	{
-		// mtx has another owner
-		currentTask -> state = BLOCKED;
-		TCB_t *blockedTask = dequeue(&priorityArray[currentTask -> priority]);
-		enqueue(&mtx -> m.wait,blockedTask);
-		printf("\nt%d block", currentTask -> task_id);
-		contextFlag = 1;
-	} else if (mtx -> m.s == 1)
-	{
-		// can acquire
-		mtx -> m.s = 0;
-		mtx -> owner = currentTask -> task_id;
-		printf("\nt%d acq", currentTask -> task_id);
-		
-		#ifdef __PRIO
-		prioInherit();
-		#endif
-	}
-	__enable_irq();
-	while(contextFlag);
-}
-void release(mutex_t *mtx)
-{
-	__disable_irq();
-	if (mtx -> m.s == 0 && mtx -> owner == currentTask -> task_id)
-	{
-		// is owner, can release
-		printf("\nt%d rel", currentTask -> task_id);
-		mtx -> m.s = 1;
-		mtx -> owner = 0;
-		contextFlag = 0;
-		if (mtx -> m.wait.size > 0)
-		{
-			TCB_t *next = dequeue(&mtx -> m.wait);
-			next -> state = READY;
-			enqueue(&priorityArray[next -> priority],&TASKS[next->task_id]);
-		}
-		#ifdef __PRIO
-		prioRestore();
-		#endif
-	}
-	else if (mtx -> m.s == 1)
-	{
-		// mtx not owned
-		printf("\nt%d no owner", currentTask -> task_id);
-	}
-	else if (mtx -> m.s == 0 && mtx -> owner != currentTask -> task_id)
-	{
-		// not owner
-		printf("\nt%d not owner", currentTask -> task_id);
-	}
-	__enable_irq();
-}
-
-
-bool osKernelInitialize(void)
-{
-	uint32_t *vectorTable = 0x0;
-	uint32_t mainStack = vectorTable[0];
-	// initialize each TCB with the base address for its stack
-	
-	for(int i = 0; i<6; i++)
-	{
-		// i = 0,1,2,3,4,5
-		
-		int task_id = 5-i;
-		TASKS[task_id].stack_addr =  mainStack - 2048 - 1024*i;
-		TASKS[task_id].task_id = task_id;
-		TASKS[task_id].state = INACTIVE;
-		TASKS[task_id].priority = IDLE;
-	}
-	
-	for(int i = 0; i<NUM_PRIORITIES; i++)
-	{
-		queue_init(&priorityArray[i]);
-	}
-	
-	return true;
-}
-
-void osThreadStart(rtosTaskFunc_t task, void *arg, priority_t priority)
-{
-	printf("\ninit t%d p%d",num_tasks,priority);
-	TCB_t *current_task = &TASKS[num_tasks];
-	
-	current_task -> priority = priority;
-	current_task -> oldPriority = priority;
-	
-	uint32_t *PSR = (uint32_t *)(current_task -> stack_addr);
-	uint32_t *R0 = (uint32_t *)(current_task -> stack_addr - 7*sizeof(uint32_t));
-	uint32_t *PC = (uint32_t *)(current_task -> stack_addr - sizeof(uint32_t));
-	
-	*PSR = 0x01000000;
-	
-	*PC = (uint32_t)(task);
-	
-	*R0 = (uint32_t)(arg);
-	
-	// populate R4-R11
-	for (int i = 0; i<8; i++)
-	{
-		// i = 0,1,2,3,4,5,6,7
-		uint32_t *curr = (uint32_t *)(current_task ->stack_addr - (15-i)*sizeof(uint32_t));
-		
-		*curr = 0xAB000001 + num_tasks;
-	}
-	
-	for (int i = 9; i<14; i++)
-	{
-		uint32_t *curr = (uint32_t *)(current_task -> stack_addr - (15-i)*sizeof(uint32_t));
-		
-		*curr = 0xFFFF0001 + num_tasks;
-	}
-	
-	current_task -> stack_addr -= 15*4;
-	
-	if (num_tasks > 0)
-		enqueue(&priorityArray[TASKS[num_tasks].priority],&TASKS[num_tasks]);
-	
-	num_tasks++;
-}
-
-sem_t sem;
-mutex_t mtx;
-
-void t0(void *arg)
-{
-	while(1)
-	{	
-		__disable_irq();
-		printf("\nIDLE");
-		__enable_irq();
-		
-		Delay(1);
-	}
-}
-
-void terminate()
-{
-	int idx = currentTask -> task_id;
-	TASKS[idx].state = TERMINATED;
-	TASKS[idx].stack_addr = TASKS[0].stack_addr;
-	TASKS[idx].priority = IDLE;
-}
-
-void t1(void *arg)
-{
-	while(1)
-	{
-		if (TASKS[1].state != TERMINATED)
-		{
-			
-			#ifdef __PRIO
-			acquire(&mtx);
-			for(int i = 0; i < 15; i++)
-			{
-				__disable_irq();
-				printf("\nt1");
-				__enable_irq();
-				Delay(1);
-			}
-			release(&mtx);
-			TASKS[1].state = TERMINATED;
-			#endif
-			
-			#ifdef __MTX
-			acquire(&mtx);
-			__disable_irq();
-			printf("\nt1 has mtx");
-			__enable_irq();
-			release(&mtx);
-			#endif
-			
-			#ifdef __SEM
-			wait_sem(&sem);
-			__disable_irq();
-			printf("\nt1 has sem");
-			__enable_irq();
-			Delay(5);
-			signal_sem(&sem);
-			#endif
-			
-			#ifdef __FPP
-			__disable_irq();
-			printf("\nt1 %d", fpp_count[1]);
-			__enable_irq();
-			fpp_count[1]--;
-			if (fpp_count[1] == 0)
-			{
-				TASKS[1].state = TERMINATED;
-			}
-			#endif
-			
-			#ifdef __CONTEXT
-			__disable_irq();
-			printf("\nt1");
-			__enable_irq();
-			#endif
-			
-			Delay(1);
-		}
-	}
-}
-
-
-void t2(void *arg)
-{
-	while(1)
-	{
-		if (TASKS[2].state != TERMINATED)
-		{
-			
-			#ifdef __PRIO
-			__disable_irq();
-			printf("\nt2");
-			__enable_irq();
-			Delay(1);
-			#endif
-			
-			#ifdef __MTX
-			Delay(10);
-			release(&mtx);
-			#endif
-			
-			#ifdef __SEM
-			wait_sem(&sem);
-			__disable_irq();
-			printf("\nt2 has sem");
-			__enable_irq();
-			Delay(5);
-			signal_sem(&sem);
-			#endif
-			
-			#ifdef __FPP
-			__disable_irq();
-			printf("\nt2 %d", fpp_count[2]);
-			__enable_irq();
-			fpp_count[2]--;
-			if (fpp_count[2] == 0)
-			{
-				TASKS[2].state = TERMINATED;
-			}
-			#endif
-			
-			#ifdef __CONTEXT
-			__disable_irq();
-			printf("\nt2");
-			__enable_irq();
-			#endif
-			
-			Delay(1);
-		}
-	}
-}
-
-void t3(void *arg)
-{
-	while(1)
-	{
-		if (TASKS[3].state != TERMINATED)
-		{
-			
-			#ifdef __PRIO
-			acquire(&mtx);
-			for (int i = 0 ; i < 5; i++)
-			{
-				__disable_irq();
-				printf("\nt3 %d", i);
-				__enable_irq();
-				Delay(1);
-			}
-			release(&mtx);
-			#endif
-			
-			#ifdef __FPP
-			__disable_irq();
-			printf("\nt3 %d", fpp_count[3]);
-			__enable_irq();
-			
-			fpp_count[3]--;
-			if (fpp_count[3] == 0)
-			{
-				TASKS[3].state = TERMINATED;
-			}
-			#endif
-			
-			Delay(1);
-		}
-	}
-}
-
-void t4(void *arg)
-{
-	while(1)
-	{
-		if (TASKS[4].state != TERMINATED)
-		{
-			
-			#ifdef __FPP
-			__disable_irq();
-			printf("\nt4 %d", fpp_count[4]);
-			__enable_irq();
-			fpp_count[4]--;
-			if (fpp_count[4] == 0)
-			{
-				TASKS[4].state = TERMINATED;
-			}
-			#endif
-			
-			Delay(1);
-		}
-	}
-}
-
-void t5(void *arg)
-{
-	while(1)
-	{
-		if (TASKS[5].state != TERMINATED)
-		{
-			
-			#ifdef __FPP
-			__disable_irq();
-			printf("\nt5 %d", fpp_count[5]);
-			__enable_irq();
-			fpp_count[5]--;
-			if (fpp_count[5] == 0)
-			{
-				TASKS[5].state = TERMINATED;
-			}
-			#endif
-			
-			Delay(1);
-		}
-	}
-}
-
-void osKernelStart(void)
-{
-	uint32_t *vectorTable = 0x0;
-	uint32_t mainStack = vectorTable[0];
-	__set_MSP(mainStack);
-	
-	//Switch from MSP to PSP
-	__set_CONTROL(__get_CONTROL() | 0x02);
-	__set_PSP(TASKS[0].stack_addr);
-	
-	NVIC_SetPriority(SysTick_IRQn, 0x00);
-	NVIC_SetPriority(PendSV_IRQn, 0xff);
-	
-	currentTask = &TASKS[0];
-	stackPointer_current = currentTask -> stack_addr;
-	
-	printf("\n\nStarting...\n\n");
-	
-	SysTick_Config(SystemCoreClock/100);
-	t0(NULL);
-}
-
-int t2Started = 0;
-int t3Started = 0;
-
-void SysTick_Handler(void) {
-	msTicks++;
-	
-	#ifdef __PRIO
-	if (msTicks > 3 && !t2Started)
-	{
-		osThreadStart(t2,NULL,HIGH);
-		t2Started = 1;
-	}
-	if (msTicks > 10 && !t3Started)
-	{
-		osThreadStart(t3,NULL,NORMAL);
-		t3Started = 1;
-	}
-	#endif
-	
-	#ifndef __CONTEXT
-	if (currentTask -> state != TERMINATED && currentTask -> state != BLOCKED)
-		enqueue(&priorityArray[currentTask -> priority],&TASKS[currentTask -> task_id]);
-	// find next task to run
-	uint8_t nextQueue__idx = 31 - __clz(bitVector);
-	TCB_t nextTask = *priorityArray[nextQueue__idx].head;
-	
-	if (currentTask -> task_id != nextTask.task_id)						// no need to perform context switch if the same task it queued up 
-	{
-		readyTask = dequeue(&priorityArray[nextQueue__idx]);
-		stackPointer_next = readyTask -> stack_addr;
-		
-		SCB -> ICSR |= 1 << 28;
-	} else {
-		dequeue(&priorityArray[nextQueue__idx]);
-	}
-	#endif
-	
-	#ifdef __CONTEXT
-	if (msTicks % 3 == 0)
-	{
-		
-		if (SWITCH == 0)
-		{
-			SWITCH = 2;
-		}
-		else if (SWITCH == 2)
-		{
-			SWITCH = 1;
-		}
-		else if (SWITCH == 1)
-		{
-			SWITCH = 0;
-		}
-		
-		readyTask = &TASKS[SWITCH];
-		stackPointer_next = readyTask -> stack_addr;
-		
-		SCB -> ICSR |= 1 << 28;
-	}
-	#endif
-}
-
-__asm void contextSwitch (void)
-{
-	MRS R1,MSP
-	MRS R0,PSP
-	
-	STMFD R0!,{R4-R11}
-	LDR R4,=__cpp(&stackPointer_current)
-	STR R0,[R4]
-	
-	LDR R4,=__cpp(&stackPointer_next)
-	LDR R0,[R4]
-	LDMFD R0!,{R4-R11}
-	
-	MSR PSP,R0
-	MSR MSP,R1
-	
-	/*
-	LDR R1,=0x00000000
-	LDR R0,=__cpp(&sysTickFlag)
-	*/
-	
-	BX		LR
-}
-
-void PendSV_Handler(void) 
-{
-	// printf("\nswitch from t%d to t%d",currentTask -> task_id, readyTask -> task_id);
-	contextSwitch();
-	TASKS[currentTask -> task_id].stack_addr = stackPointer_current;
-	TASKS[currentTask -> task_id].state = READY;
-	TASKS[readyTask -> task_id].stack_addr = stackPointer_next;
-	TASKS[readyTask -> task_id].state = RUNNING;
-	currentTask = readyTask;
-}
-
-int main(void) {
-	// default code
-	printf("\n\n\n--- system init ---\n");
-	osKernelInitialize();
-	osThreadStart(t0,NULL,IDLE);
-	
-	#ifdef __CONTEXT
-	// context switching
-	osThreadStart(t1,NULL,NORMAL);
-	osThreadStart(t2,NULL,NORMAL);
-	osThreadStart(t3,NULL,NORMAL);
-	#endif
-	
-	#ifdef __FPP
-	// FPP scheduling
-	osThreadStart(t1,NULL,HIGH);
-	osThreadStart(t2,NULL,HIGH);
-	osThreadStart(t3,NULL,NORMAL);
-	osThreadStart(t4,NULL,LOW);
-	osThreadStart(t5,NULL,LOW);
-	#endif
-	
-	#ifdef __SEM
-	// blocking semaphores
-	init_sem(&sem,1);
-	osThreadStart(t1,NULL,NORMAL);
-	osThreadStart(t2,NULL,NORMAL);
-	#endif
-	
-	#ifdef __MTX
-	init_mtx(&mtx);
-	osThreadStart(t1,NULL,NORMAL);
-	osThreadStart(t2,NULL,NORMAL);
-	#endif
-	
-	#ifdef __PRIO
-	init_mtx(&mtx);
-	osThreadStart(t1,NULL,LOW);
-	#endif
-	
-	osKernelStart();
-	
-}
+/*
+ * Default main.c for rtos lab.
+ * @author Andrew Morton, 2018
+ */
+#include <LPC17xx.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "types.c"
+#include "oslog.h"
+
+// demo mode, one of __CONTEXT __FPP __SEM __MTX __PRIO __DEADLINE __EVENT
+// or a benchmark: __BENCH_TICK __BENCH_PINGPONG __BENCH_PRODCONS __BENCH_MUTEX __BENCH_MSGQ
+// __BENCH_IRQLAT. Define one here or pass it with -D, __PRIO is built when none is given.
+// It has to come before the kernel configuration, which sizes the benchmarks from it
+//#define __SEM
+#if !defined(__CONTEXT) && !defined(__FPP) && !defined(__SEM) && !defined(__MTX) && !defined(__PRIO) \
+	&& !defined(__DEADLINE) && !defined(__EVENT) && !defined(__BENCH_TICK) && !defined(__BENCH_PINGPONG) \
+	&& !defined(__BENCH_PRODCONS) && !defined(__BENCH_MUTEX) && !defined(__BENCH_MSGQ) && !defined(__BENCH_IRQLAT)
+#define __PRIO
+#endif
+
+// kernel configuration: TCB count and the stack pool osThreadStart() carves from
+// stacks are sized per task, tasks with their own OS_STACK() buffer use osThreadStartStatic()
+#define MIN_STACK_SIZE	128			// initial frame plus a little headroom
+#define TASK_STACK_SIZE	512			// demo tasks, printf needs most of it
+
+#ifdef __BENCH_TICK
+#define BENCH_TASKS	32			// ready tasks sharing one priority level (1, 8 or 32)
+#define BENCH_STACK_SIZE	MIN_STACK_SIZE
+#define MAX_TASKS	(BENCH_TASKS + 1)
+#define STACK_POOL_SIZE	(TASK_STACK_SIZE + (BENCH_TASKS-1)*BENCH_STACK_SIZE)
+#else
+#define MAX_TASKS	6
+#define STACK_POOL_SIZE	((MAX_TASKS-1)*TASK_STACK_SIZE)
+#endif
+
+#define TICK_HZ	100
+#define TICKLESS_IDLE	1			// stop the tick while only the idle task can run
+#define TIME_SLICE	1			// default round robin quantum in ticks, 0 lets a level run until it blocks
+#define SCHED_EDF	0			// 1: earliest deadline first over a ready heap, 0: fixed priority
+#define PREEMPT_ON_WAKE	1			// switch as soon as a woken task outranks the caller, not on the next tick
+#define OS_LOG	1					// deferred kernel log drained by the idle task, 0 compiles it out
+#define LOG_SIZE	64				// log records, a power of two
+
+// task stacks live in their own ZI section so a scatter file can place them (e.g. in AHB SRAM)
+#define OS_STACK_ALIGNED(name, size, align) \
+	uint64_t name[((size) + 7) / 8] __attribute__((section(".bss.os_stacks"), zero_init, aligned(align)))
+#define OS_STACK(name, size)	OS_STACK_ALIGNED(name, size, 8)
+// word aligned storage for init_pool()
+#define OS_POOL(name, blockSize, numBlocks) \
+	uint32_t name[(((blockSize) + 3) / 4) * (numBlocks)]
+
+// lock-free word update, an exception between LDREX and STREX clears the monitor and retries
+static __inline uint32_t atomicAdd(volatile uint32_t *word, int32_t delta)
+{
+	uint32_t value;
+	do {
+		value = __LDREXW(word) + delta;
+	} while (__STREXW(value, word) != 0);
+	return value;
+}
+static __inline void atomicMax(volatile uint32_t *word, uint32_t value)
+{
+	while (__LDREXW(word) < value)
+	{
+		if (__STREXW(value, word) == 0)
+			return;
+	}
+	__CLREX();
+}
+
+
+volatile uint32_t msTicks = 0;
+volatile uint32_t sysTickEntries = 0;	// SysTick_Handler calls, lags msTicks while idle is tickless
+uint32_t tickReload;				// core clocks per tick
+
+int num_tasks = 0;
+TCB_t TASKS[MAX_TASKS];
+OS_STACK(stackPool, STACK_POOL_SIZE);
+OS_STACK(idleStack, TASK_STACK_SIZE);
+uint32_t stackPoolUsed = 0;
+TCB_t *currentTask, *readyTask;
+bitVector_t bitVector;
+queue_t priorityArray[NUM_PRIORITIES];
+uint8_t timeSlice[NUM_PRIORITIES];	// quantum per level, see osSetTimeSlice
+#if SCHED_EDF
+TCB_t *readyHeap[MAX_TASKS];		// min-heap, readyHeap[0] has the earliest deadline
+uint32_t readyHeapSize = 0;
+#endif
+TCB_t *sleepList = NULL;		// sorted by wakeTick, earliest first
+
+int fpp_count[] = {0,5,2,5,2,5};
+int sem_count = 10;
+
+#if OS_LOG
+// lock-free ring of log records: writers (tasks or ISRs) claim a slot by advancing logHead with
+// LDREX/STREX, fill it and publish it through seq last. The idle task is the only reader
+logRecord_t logRing[LOG_SIZE];
+volatile uint32_t logHead = 0;
+volatile uint32_t logTail = 0;
+volatile uint32_t logDropped = 0;	// records lost to a full ring, reported by the drain
+const uint8_t logArgs[LOG_COUNT] = {
+#define OS_LOG_NARGS(id, nargs, format)	nargs,
+	OS_LOG_FORMATS(OS_LOG_NARGS)
+#undef OS_LOG_NARGS
+};
+
+// a few tens of cycles and no masking, safe anywhere including critical sections and ISRs
+void osLog(logId_t id, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+	uint32_t idx;
+	do {
+		idx = __LDREXW(&logHead);
+		if (idx - logTail >= LOG_SIZE)
+		{
+			__CLREX();
+			atomicAdd(&logDropped, 1);
+			return;
+		}
+	} while (__STREXW(idx + 1, &logHead) != 0);
+	
+	logRecord_t *r = &logRing[idx % LOG_SIZE];
+	r -> id = id;
+	r -> task = (currentTask != NULL) ? currentTask -> task_id : 0xFF;
+	r -> time = msTicks;
+	r -> arg[0] = a0;
+	r -> arg[1] = a1;
+	r -> arg[2] = a2;
+	__DMB();
+	r -> seq = idx + 1;
+}
+
+static void logSendFrame(const logRecord_t *r)
+{
+	uint8_t bytes[2 + 4 + 3*4];
+	uint32_t n = 0;
+	
+	bytes[n++] = r -> id;
+	bytes[n++] = r -> task;
+	for (int b = 0; b < 4; b++)
+		bytes[n++] = r -> time >> (8*b);
+	for (int a = 0; a < logArgs[r -> id]; a++)
+		for (int b = 0; b < 4; b++)
+			bytes[n++] = r -> arg[a] >> (8*b);
+	
+	// six bits per byte, least significant first
+	sendbyte(LOG_FRAME_START);
+	uint32_t bits = 0;
+	uint32_t held = 0;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		bits |= (uint32_t)bytes[i] << held;
+		held += 8;
+		while (held >= 6)
+		{
+			sendbyte(0x80 | (bits & 0x3F));
+			bits >>= 6;
+			held -= 6;
+		}
+	}
+	if (held > 0)
+		sendbyte(0x80 | (bits & 0x3F));
+}
+
+// ship published records, called by the idle task with interrupts enabled so the busy-waiting
+// port output only ever delays idle time
+void osLogDrain(void)
+{
+	while (logRing[logTail % LOG_SIZE].seq == logTail + 1)
+	{
+		logSendFrame(&logRing[logTail % LOG_SIZE]);
+		logTail++;
+	}
+	if (logDropped != 0)
+	{
+		logRecord_t r = {0};
+		r.id = LOG_DROPPED;
+		r.task = 0xFF;
+		r.time = msTicks;
+		r.arg[0] = logDropped;
+		atomicAdd(&logDropped, -(int32_t)r.arg[0]);
+		logSendFrame(&r);
+	}
+}
+#else
+#define osLog(id, a0, a1, a2)	((void)0)
+#endif
+
+// busy wait, only for the idle task which must never leave the ready set
+void Delay(uint32_t dlyTicks)
+{
+	uint32_t curTicks;
+	curTicks = msTicks;
+	
+	while((msTicks - curTicks) < dlyTicks);
+}
+
+void queue_init(queue_t *q)
+{
+	q -> head = NULL;
+	q -> tail = NULL;
+	q -> size = 0;
+}
+
+void enqueue(queue_t *q, TCB_t *t)
+{
+	t -> next = NULL;
+	t -> prev = q -> tail;
+	if (q -> size == 0)
+	{
+		q -> head = t;
+	}
+	else
+	{
+		q -> tail -> next = t;
+	}
+	q -> tail = t;
+	q -> size++;
+}
+// insert t ahead of everything on q
+void queue_push(queue_t *q, TCB_t *t)
+{
+	t -> prev = NULL;
+	t -> next = q -> head;
+	if (q -> size == 0)
+	{
+		q -> tail = t;
+	}
+	else
+	{
+		q -> head -> prev = t;
+	}
+	q -> head = t;
+	q -> size++;
+}
+TCB_t* dequeue(queue_t *q)
+{
+	TCB_t *ret = q -> head;
+	
+	if (q -> size > 0)
+	{
+		q -> head = ret -> next;
+		if (q -> head != NULL)
+			q -> head -> prev = NULL;
+		else
+			q -> tail = NULL;
+		q -> size--;
+		ret -> next = NULL;
+	}
+	return ret;
+}
+void queue_remove(queue_t *q, TCB_t *t)
+{
+	// unlink t from anywhere in q, the caller guarantees t is on q
+	if (t -> prev != NULL)
+		t -> prev -> next = t -> next;
+	else
+		q -> head = t -> next;
+	
+	if (t -> next != NULL)
+		t -> next -> prev = t -> prev;
+	else
+		q -> tail = t -> prev;
+	
+	t -> next = NULL;
+	t -> prev = NULL;
+	q -> size--;
+}
+
+void bitVector_init(bitVector_t *bv)
+{
+	bv -> group = 0;
+	for (int i = 0; i < NUM_PRIO_GROUPS; i++)
+		bv -> leaf[i] = 0;
+}
+void bitVector_set(bitVector_t *bv, priority_t p)
+{
+	bv -> leaf[p >> 5] |= 1u << (p & 31);
+	bv -> group |= 1u << (p >> 5);
+}
+void bitVector_clear(bitVector_t *bv, priority_t p)
+{
+	bv -> leaf[p >> 5] &= ~(1u << (p & 31));
+	if (bv -> leaf[p >> 5] == 0)
+		bv -> group &= ~(1u << (p >> 5));
+}
+// highest set level in two CLZ, the caller guarantees at least one bit is set
+priority_t bitVector_highest(bitVector_t *bv)
+{
+	uint32_t g = 31 - __clz(bv -> group);
+	return (priority_t)((g << 5) + 31 - __clz(bv -> leaf[g]));
+}
+
+#if SCHED_EDF
+// a task has a deadline of its own as a periodic job or one lent to it through a mutex
+bool edfKeyed(TCB_t *t)
+{
+	return t -> relDeadline != 0 || t -> deadlineLent;
+}
+// the earlier of the two, the caller checks edfKeyed
+uint32_t edfDeadline(TCB_t *t)
+{
+	if (!t -> deadlineLent || (t -> relDeadline != 0 && (int32_t)(t -> absDeadline - t -> lentDeadline) < 0))
+		return t -> absDeadline;
+	return t -> lentDeadline;
+}
+// EDF order: tasks with a deadline by absolute deadline, then tasks without one by priority
+bool edfBefore(TCB_t *a, TCB_t *b)
+{
+	if (edfKeyed(a) && edfKeyed(b))
+		return (int32_t)(edfDeadline(a) - edfDeadline(b)) < 0;
+	if (edfKeyed(a) != edfKeyed(b))
+		return edfKeyed(a);
+	return a -> priority > b -> priority;
+}
+void heap_place(uint32_t i, TCB_t *t)
+{
+	readyHeap[i] = t;
+	t -> heapIndex = i;
+}
+void heap_siftUp(uint32_t i)
+{
+	TCB_t *t = readyHeap[i];
+	while (i > 0 && edfBefore(t, readyHeap[(i - 1) / 2]))
+	{
+		heap_place(i, readyHeap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	heap_place(i, t);
+}
+void heap_siftDown(uint32_t i)
+{
+	TCB_t *t = readyHeap[i];
+	while (2*i + 1 < readyHeapSize)
+	{
+		uint32_t c = 2*i + 1;
+		if (c + 1 < readyHeapSize && edfBefore(readyHeap[c + 1], readyHeap[c]))
+			c++;
+		if (!edfBefore(readyHeap[c], t))
+			break;
+		heap_place(i, readyHeap[c]);
+		i = c;
+	}
+	heap_place(i, t);
+}
+
+// ready set: readyHeap keyed by absolute deadline, insert and remove are O(log n)
+void readyEnqueue(TCB_t *t)
+{
+	heap_place(readyHeapSize++, t);
+	heap_siftUp(t -> heapIndex);
+	t -> state = READY;
+}
+void readyRemove(TCB_t *t)
+{
+	uint32_t i = t -> heapIndex;
+	TCB_t *last = readyHeap[--readyHeapSize];
+	if (last != t)
+	{
+		heap_place(i, last);
+		heap_siftUp(i);
+		heap_siftDown(last -> heapIndex);
+	}
+}
+// the heap keeps no order among equal keys, so this is readyEnqueue
+void readyEnqueueHead(TCB_t *t)
+{
+	readyEnqueue(t);
+}
+TCB_t *readyFirst(void)
+{
+	return readyHeap[0];
+}
+// true if a woken task t should run before the task picked to run. That is readyTask rather
+// than currentTask, which may already have blocked with the switch away still pending
+bool readyPreempts(TCB_t *t)
+{
+	return edfBefore(t, readyTask);
+}
+#else
+// ready set: priorityArray plus one bitVector bit per non-empty level
+// the running task stays at the head of its level until it blocks or is rotated
+void readyEnqueue(TCB_t *t)
+{
+	enqueue(&priorityArray[t -> priority], t);
+	bitVector_set(&bitVector, t -> priority);
+	t -> state = READY;
+	t -> sliceLeft = timeSlice[t -> priority];
+}
+// ahead of the other tasks at its level, for a task raised while it runs
+void readyEnqueueHead(TCB_t *t)
+{
+	queue_push(&priorityArray[t -> priority], t);
+	bitVector_set(&bitVector, t -> priority);
+	t -> state = READY;
+	t -> sliceLeft = timeSlice[t -> priority];
+}
+void readyRemove(TCB_t *t)
+{
+	queue_remove(&priorityArray[t -> priority], t);
+	if (priorityArray[t -> priority].size == 0)
+		bitVector_clear(&bitVector, t -> priority);
+}
+TCB_t *readyFirst(void)
+{
+	return priorityArray[bitVector_highest(&bitVector)].head;
+}
+bool readyPreempts(TCB_t *t)
+{
+	return t -> priority > readyTask -> priority;
+}
+#endif
+
+// pick the task to run, the running task keeps the CPU while it is first in the ready set
+// call with interrupts disabled or from a handler, the switch happens in PendSV
+void schedule(void)
+{
+	// readyTask is refreshed even without a switch so a PendSV already pending never runs a stale choice
+	readyTask = readyFirst();
+	
+	if (readyTask != currentTask)
+	{
+		SCB -> ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
+
+// set the round robin quantum of one level in ticks (up to 255), 0 turns slicing off for it
+// a task keeps the rest of its slice while a higher level preempts it
+void osSetTimeSlice(priority_t priority, uint8_t ticks)
+{
+	uint32_t irq = osCriticalEnter();
+	timeSlice[priority] = ticks;
+	for (TCB_t *t = priorityArray[priority].head; t != NULL; t = t -> next)
+		t -> sliceLeft = ticks;
+	osCriticalExit(irq);
+}
+
+// ready a woken task, with PREEMPT_ON_WAKE the caller is preempted at once if it is outranked
+// equal priority wakers queue behind the running task and wait for their turn
+void wakeTask(TCB_t *t)
+{
+	readyEnqueue(t);
+	#if PREEMPT_ON_WAKE
+	if (currentTask != NULL && readyPreempts(t))
+		schedule();
+	#endif
+}
+
+// sleep list: insert walks past tasks waking no later than t so equal wake times stay FIFO,
+// SysTick only ever pops the head so its cost depends on the tasks waking, not on the sleepers
+void sleep_insert(TCB_t *t, uint32_t wakeTick)
+{
+	TCB_t *prev = NULL;
+	TCB_t *curr = sleepList;
+	
+	while (curr != NULL && (int32_t)(curr -> wakeTick - wakeTick) <= 0)
+	{
+		prev = curr;
+		curr = curr -> sleepNext;
+	}
+	
+	t -> wakeTick = wakeTick;
+	t -> sleepPrev = prev;
+	t -> sleepNext = curr;
+	if (prev != NULL)
+		prev -> sleepNext = t;
+	else
+		sleepList = t;
+	if (curr != NULL)
+		curr -> sleepPrev = t;
+}
+void sleep_remove(TCB_t *t)
+{
+	if (t -> sleepPrev != NULL)
+		t -> sleepPrev -> sleepNext = t -> sleepNext;
+	else
+		sleepList = t -> sleepNext;
+	if (t -> sleepNext != NULL)
+		t -> sleepNext -> sleepPrev = t -> sleepPrev;
+	t -> sleepNext = NULL;
+	t -> sleepPrev = NULL;
+}
+
+// block the calling task until msTicks reaches wakeTick, returns at once if it already has
+// a periodic task keeps its own release time and adds the period each cycle so it never drifts
+void osDelayUntil(uint32_t wakeTick)
+{
+	uint32_t irq = osCriticalEnter();
+	if ((int32_t)(wakeTick - msTicks) > 0)
+	{
+		readyRemove(currentTask);
+		currentTask -> state = SLEEPING;
+		sleep_insert(currentTask, wakeTick);
+		schedule();
+	}
+	osCriticalExit(irq);
+}
+
+// block the calling task for dlyTicks ticks
+void osDelay(uint32_t dlyTicks)
+{
+	osDelayUntil(msTicks + dlyTicks);
+}
+
+// end the current job of a periodic task and sleep until its next release
+// a job finishing after its absolute deadline is counted in deadlineMisses
+void osWaitNextPeriod(void)
+{
+	uint32_t irq = osCriticalEnter();
+	TCB_t *t = currentTask;
+	if ((int32_t)(msTicks - t -> absDeadline) > 0)
+		t -> deadlineMisses++;
+	
+	// the deadline is the heap key, so leave the ready set before changing it
+	readyRemove(t);
+	t -> release += t -> period;
+	t -> absDeadline = t -> release + t -> relDeadline;
+	if ((int32_t)(t -> release - msTicks) > 0)
+	{
+		t -> state = SLEEPING;
+		sleep_insert(t, t -> release);
+	}
+	else
+	{
+		readyEnqueue(t);
+	}
+	schedule();
+	osCriticalExit(irq);
+}
+
+// spin until the calling task has been charged ticks ticks of CPU time, stands in for job work
+void burn(uint32_t ticks)
+{
+	TCB_t *self = currentTask;
+	uint32_t start = self -> runTicks;
+	
+	while (self -> runTicks - start < ticks);
+}
+
+void waitq_init(waitq_t *w)
+{
+	bitVector_init(&w -> levels);
+	for (int i = 0; i < NUM_PRIORITIES; i++)
+		w -> bucket[i] = NULL;
+	w -> size = 0;
+}
+// a level's next links end in NULL, the head's prev is the tail so appending is O(1)
+void waitq_insert(waitq_t *w, TCB_t *t)
+{
+	TCB_t *head = w -> bucket[t -> priority];
+	
+	t -> next = NULL;
+	if (head == NULL)
+	{
+		w -> bucket[t -> priority] = t;
+		t -> prev = t;
+		bitVector_set(&w -> levels, t -> priority);
+	}
+	else
+	{
+		t -> prev = head -> prev;
+		head -> prev -> next = t;
+		head -> prev = t;
+	}
+	w -> size++;
+	t -> waitq = w;
+}
+void waitq_remove(waitq_t *w, TCB_t *t)
+{
+	TCB_t *head = w -> bucket[t -> priority];
+	
+	if (t == head)
+	{
+		w -> bucket[t -> priority] = t -> next;
+		if (t -> next != NULL)
+			t -> next -> prev = t -> prev;		// the tail moves to the new head
+		else
+			bitVector_clear(&w -> levels, t -> priority);
+	}
+	else
+	{
+		t -> prev -> next = t -> next;
+		if (t -> next != NULL)
+			t -> next -> prev = t -> prev;
+		else
+			head -> prev = t -> prev;			// t was the tail
+	}
+	t -> next = NULL;
+	t -> prev = NULL;
+	w -> size--;
+	t -> waitq = NULL;
+}
+// priority of the highest waiter, the caller checks w is not empty
+priority_t waitq_top(waitq_t *w)
+{
+	return bitVector_highest(&w -> levels);
+}
+// take the highest waiter, the longest waiting one among equals, NULL if w is empty
+TCB_t *waitq_pop(waitq_t *w)
+{
+	if (w -> size == 0)
+		return NULL;
+	TCB_t *t = w -> bucket[waitq_top(w)];
+	waitq_remove(w, t);
+	return t;
+}
+
+// change the effective priority of t, a ready or waiting task moves to the queue of its new level.
+// A raised task goes to the head of it, so a ceiling holder is not queued behind the other users
+void setPriority(TCB_t *t, priority_t priority)
+{
+	if (t -> priority == priority)
+		return;
+	if (t -> state == READY)
+	{
+		bool raised = priority > t -> priority;
+		readyRemove(t);
+		t -> priority = priority;
+		if (raised)
+			readyEnqueueHead(t);
+		else
+			readyEnqueue(t);
+	}
+	else if (t -> state == BLOCKED && t -> waitq != NULL)
+	{
+		waitq_t *w = t -> waitq;
+		waitq_remove(w, t);
+		t -> priority = priority;
+		waitq_insert(w, t);
+	}
+	else
+	{
+		t -> priority = priority;
+	}
+}
+
+// raise t to priority and pass the boost down the chain of owners t is blocked behind
+// the walk stops at the first owner already at or above priority, so a cycle cannot loop
+void prioInherit(TCB_t *t, priority_t priority)
+{
+	while (t != NULL && t -> priority < priority)
+	{
+		setPriority(t, priority);
+		t = (t -> blockedOn != NULL) ? t -> blockedOn -> owner : NULL;
+	}
+}
+
+#if SCHED_EDF
+// change the deadline lent to t, a ready task is re-placed in the heap under its new key
+// returns true if it changed
+bool setLentDeadline(TCB_t *t, bool lent, uint32_t deadline)
+{
+	bool ready = (t -> state == READY);
+	
+	if (t -> deadlineLent == lent && (!lent || t -> lentDeadline == deadline))
+		return false;
+	if (ready)
+		readyRemove(t);
+	t -> deadlineLent = lent;
+	t -> lentDeadline = deadline;
+	if (ready)
+		readyEnqueue(t);
+	return true;
+}
+
+// the EDF counterpart of prioInherit: lend the deadline of from down the chain of owners
+// it is blocked behind, stopping at the first owner already due as early
+void deadlineInherit(TCB_t *t, TCB_t *from)
+{
+	if (!edfKeyed(from))
+		return;
+	uint32_t deadline = edfDeadline(from);
+	while (t != NULL && (!edfKeyed(t) || (int32_t)(deadline - edfDeadline(t)) < 0))
+	{
+		setLentDeadline(t, true, deadline);
+		t = (t -> blockedOn != NULL) ? t -> blockedOn -> owner : NULL;
+	}
+}
+
+// lend t the earliest deadline among the waiters on the mutexes it holds, or none
+// returns true if that changed
+bool deadlineRestore(TCB_t *t)
+{
+	bool lent = false;
+	uint32_t deadline = 0;
+	
+	for (mutex_t *m = t -> heldMutexes; m != NULL; m = m -> nextHeld)
+	{
+		// visit only the non-empty buckets, clearing each level of a copy of the bitmap
+		bitVector_t levels = m -> wait.levels;
+		while (levels.group != 0)
+		{
+			priority_t p = bitVector_highest(&levels);
+			bitVector_clear(&levels, p);
+			for (TCB_t *w = m -> wait.bucket[p]; w != NULL; w = w -> next)
+			{
+				if (edfKeyed(w) && (!lent || (int32_t)(edfDeadline(w) - deadline) < 0))
+				{
+					lent = true;
+					deadline = edfDeadline(w);
+				}
+			}
+		}
+	}
+	return setLentDeadline(t, lent, deadline);
+}
+#endif
+
+// drop t to the highest priority still required: its own, a waiter on any mutex it holds,
+// or the ceiling of any ceiling mutex it holds. Under SCHED_EDF the lent deadline is
+// recomputed the same way. Returns true if either changed
+bool prioRestore(TCB_t *t)
+{
+	priority_t before = t -> priority;
+	priority_t priority = t -> basePriority;
+	for (mutex_t *m = t -> heldMutexes; m != NULL; m = m -> nextHeld)
+	{
+		if (m -> protocol == PRIO_CEILING && m -> ceiling > priority)
+			priority = m -> ceiling;
+		if (m -> wait.size > 0 && waitq_top(&m -> wait) > priority)
+			priority = waitq_top(&m -> wait);
+	}
+	setPriority(t, priority);
+	
+	bool changed = (t -> priority != before);
+	#if SCHED_EDF
+	if (deadlineRestore(t))
+		changed = true;
+	#endif
+	return changed;
+}
+
+// a task lent a higher priority or holding a ceiling mutex is not rotated at the end of its
+// slice. Another user of the ceiling getting in would find the mutex taken and block, which
+// the ceiling protocol rules out
+bool sliceExempt(TCB_t *t)
+{
+	if (t -> priority > t -> basePriority)
+		return true;
+	for (mutex_t *m = t -> heldMutexes; m != NULL; m = m -> nextHeld)
+	{
+		if (m -> protocol == PRIO_CEILING)
+			return true;
+	}
+	return false;
+}
+
+// the rest of blocking once the caller is out of the ready set, see blockSelf
+void blockPend(uint32_t timeout)
+{
+	currentTask -> state = BLOCKED;
+	currentTask -> waitStatus = OS_WAITING;
+	if (timeout != OS_WAIT_FOREVER)
+		sleep_insert(currentTask, msTicks + timeout);
+	schedule();
+}
+// take the caller out of the ready set and pend the switch away
+// with a timeout other than OS_WAIT_FOREVER the task also goes on the sleep list and
+// is taken off it again if woken first, see wakeWaiter and SysTick_Handler
+// call with interrupts disabled, PendSV runs as soon as they are enabled again and the
+// caller resumes there once a waker has set its waitStatus and readied it
+void blockSelf(uint32_t timeout)
+{
+	readyRemove(currentTask);
+	blockPend(timeout);
+}
+// the idle task is TASKS[0] and must never leave the ready set
+bool osCanBlock(void)
+{
+	return currentTask != NULL && currentTask != &TASKS[0]
+		&& __get_IPSR() == 0 && __get_BASEPRI() == 0 && __get_PRIMASK() == 0;
+}
+// block on wait queue w, the waker or the timeout takes the task off it. The ready and wait
+// queues share the next/prev links, so the task leaves the ready set before joining w
+void blockOn(waitq_t *w, uint32_t timeout)
+{
+	readyRemove(currentTask);
+	waitq_insert(w, currentTask);
+	blockPend(timeout);
+}
+// take a task woken before its timeout off the sleep list
+void cancelTimeout(TCB_t *t)
+{
+	if (t -> sleepPrev != NULL || sleepList == t)
+		sleep_remove(t);
+}
+// ready a task already taken off its wait queue, cancelling its timeout
+void wakeWaiter(TCB_t *t, osStatus_t status)
+{
+	cancelTimeout(t);
+	t -> waitStatus = status;
+	wakeTask(t);
+}
+// wake the highest priority task waiting on w with status, returns it or NULL if w was empty
+TCB_t *wakeOne(waitq_t *w, osStatus_t status)
+{
+	TCB_t *t = waitq_pop(w);
+	if (t != NULL)
+		wakeWaiter(t, status);
+	return t;
+}
+
+void init_sem(sem_t *sem, uint32_t count)
+{
+	sem -> s = count;
+	waitq_init(&(sem -> wait));
+	
+}
+// s counts the free units, a signal with waiters hands its unit straight to the highest one
+// so a waiter that times out leaves the count untouched
+osStatus_t wait_sem_timeout(sem_t *sem, uint32_t timeout)
+{
+	osStatus_t status = OS_OK;
+	uint32_t irq = osCriticalEnter();
+	osLog(LOG_SEM_REQ, 0, 0, 0);
+	if (sem -> s > 0)
+	{
+		(sem -> s)--;
+	}
+	else if (timeout == 0)
+	{
+		status = OS_TIMEOUT;
+	}
+	else
+	{
+		osLog(LOG_SEM_WAIT, 0, 0, 0);
+		blockOn(&sem -> wait, timeout);
+		osCriticalExit(irq);
+		irq = osCriticalEnter();
+		status = currentTask -> waitStatus;
+	}
+	osCriticalExit(irq);
+	return status;
+}
+void wait_sem(sem_t *sem)
+{
+	wait_sem_timeout(sem, OS_WAIT_FOREVER);
+}
+void signal_sem(sem_t *sem)
+{
+	uint32_t irq = osCriticalEnter();
+	osLog(LOG_SEM_REL, 0, 0, 0);
+	if (wakeOne(&sem -> wait, OS_OK) == NULL)
+	{
+		(sem -> s)++;
+	}
+	osCriticalExit(irq);
+}
+
+void init_evt(event_t *evt)
+{
+	evt -> flags = 0;
+	waitq_init(&evt -> wait);
+}
+static bool evtSatisfied(uint32_t flags, uint32_t mask, uint8_t options)
+{
+	if (options & EVT_WAIT_ALL)
+		return (flags & mask) == mask;
+	return (flags & mask) != 0;
+}
+// set flags and wake every waiter they satisfy in one pass, with PREEMPT_ON_WAKE a single reschedule at the end.
+// Waiters are checked against the flags as set here, the bits they clear are dropped afterwards
+// so one auto-clearing waiter cannot starve another woken by the same set. Safe from an ISR
+uint32_t set_evt(event_t *evt, uint32_t flags)
+{
+	uint32_t clear = 0;
+	bool woken = false;
+	
+	uint32_t irq = osCriticalEnter();
+	evt -> flags |= flags;
+	flags = evt -> flags;
+	// visit only the non-empty levels, highest first, from a copy of the bitmap that is cleared
+	// as it goes since waitq_remove changes the live one
+	bitVector_t levels = evt -> wait.levels;
+	while (levels.group != 0)
+	{
+		priority_t p = bitVector_highest(&levels);
+		bitVector_clear(&levels, p);
+		TCB_t *t = evt -> wait.bucket[p];
+		while (t != NULL)
+		{
+			TCB_t *next = t -> next;
+			if (evtSatisfied(flags, t -> eventFlags, t -> eventOptions))
+			{
+				if (!(t -> eventOptions & EVT_NO_CLEAR))
+					clear |= t -> eventFlags;
+				waitq_remove(&evt -> wait, t);
+				cancelTimeout(t);
+				t -> eventFlags = flags;
+				t -> waitStatus = OS_OK;
+				readyEnqueue(t);
+				woken = true;
+			}
+			t = next;
+		}
+	}
+	evt -> flags &= ~clear;
+	#if PREEMPT_ON_WAKE
+	if (woken && currentTask != NULL)
+		schedule();
+	#endif
+	osCriticalExit(irq);
+	return flags;
+}
+uint32_t clear_evt(event_t *evt, uint32_t flags)
+{
+	uint32_t irq = osCriticalEnter();
+	uint32_t before = evt -> flags;
+	evt -> flags = before & ~flags;
+	osCriticalExit(irq);
+	return before;
+}
+// wait until any (EVT_WAIT_ANY) or all (EVT_WAIT_ALL) of mask is set, the matched bits are
+// cleared unless EVT_NO_CLEAR. *flags gets the group's flags at the moment the wait was satisfied
+osStatus_t wait_evt(event_t *evt, uint32_t mask, uint8_t options, uint32_t timeout, uint32_t *flags)
+{
+	osStatus_t status = OS_OK;
+	uint32_t irq = osCriticalEnter();
+	uint32_t current = evt -> flags;
+	if (evtSatisfied(current, mask, options))
+	{
+		if (!(options & EVT_NO_CLEAR))
+			evt -> flags = current & ~mask;
+	}
+	else if (timeout == 0)
+	{
+		status = OS_TIMEOUT;
+	}
+	else
+	{
+		currentTask -> eventFlags = mask;
+		currentTask -> eventOptions = options;
+		blockOn(&evt -> wait, timeout);
+		osCriticalExit(irq);
+		irq = osCriticalEnter();
+		status = currentTask -> waitStatus;
+		current = (status == OS_OK) ? currentTask -> eventFlags : evt -> flags;
+	}
+	osCriticalExit(irq);
+	if (flags != NULL)
+		*flags = current;
+	return status;
+}
+
+// buf holds capacity messages of msgSize bytes, a capacity of 0 makes every send a rendezvous
+void init_msgq(msgq_t *q, void *buf, uint32_t msgSize, uint32_t capacity)
+{
+	q -> buf = buf;
+	q -> msgSize = msgSize;
+	q -> capacity = capacity;
+	q -> count = 0;
+	q -> head = 0;
+	q -> tail = 0;
+	waitq_init(&q -> senders);
+	waitq_init(&q -> receivers);
+}
+// pointer sized messages are the zero-copy case and skip memcpy
+static void msgCopy(void *dst, const void *src, uint32_t size)
+{
+	if (size == sizeof(void *))
+		*(void **)dst = *(void *const *)src;
+	else
+		memcpy(dst, src, size);
+}
+// a waiting receiver is handed the message directly, otherwise it is queued. With timeout 0
+// send_msgq never blocks and is safe from an ISR
+osStatus_t send_msgq(msgq_t *q, const void *msg, uint32_t timeout)
+{
+	osStatus_t status = OS_OK;
+	uint32_t irq = osCriticalEnter();
+	TCB_t *r = waitq_pop(&q -> receivers);
+	if (r != NULL)
+	{
+		msgCopy(r -> msgPtr, msg, q -> msgSize);
+		wakeWaiter(r, OS_OK);
+	}
+	else if (q -> count < q -> capacity)
+	{
+		msgCopy(q -> buf + q -> tail * q -> msgSize, msg, q -> msgSize);
+		if (++(q -> tail) == q -> capacity)
+			q -> tail = 0;
+		q -> count++;
+	}
+	else if (timeout == 0)
+	{
+		status = OS_TIMEOUT;
+	}
+	else
+	{
+		currentTask -> msgPtr = (void *)msg;
+		blockOn(&q -> senders, timeout);
+		osCriticalExit(irq);
+		irq = osCriticalEnter();
+		status = currentTask -> waitStatus;
+	}
+	osCriticalExit(irq);
+	return status;
+}
+// take the oldest message, the slot it frees goes straight to the highest waiting sender
+osStatus_t recv_msgq(msgq_t *q, void *msg, uint32_t timeout)
+{
+	osStatus_t status = OS_OK;
+	uint32_t irq = osCriticalEnter();
+	TCB_t *s;
+	if (q -> count > 0)
+	{
+		msgCopy(msg, q -> buf + q -> head * q -> msgSize, q -> msgSize);
+		if (++(q -> head) == q -> capacity)
+			q -> head = 0;
+		q -> count--;
+		s = waitq_pop(&q -> senders);
+		if (s != NULL)
+		{
+			msgCopy(q -> buf + q -> tail * q -> msgSize, s -> msgPtr, q -> msgSize);
+			if (++(q -> tail) == q -> capacity)
+				q -> tail = 0;
+			q -> count++;
+			wakeWaiter(s, OS_OK);
+		}
+	}
+	else if ((s = waitq_pop(&q -> senders)) != NULL)
+	{
+		msgCopy(msg, s -> msgPtr, q -> msgSize);
+		wakeWaiter(s, OS_OK);
+	}
+	else if (timeout == 0)
+	{
+		status = OS_TIMEOUT;
+	}
+	else
+	{
+		currentTask -> msgPtr = msg;
+		blockOn(&q -> receivers, timeout);
+		osCriticalExit(irq);
+		irq = osCriticalEnter();
+		status = currentTask -> waitStatus;
+	}
+	osCriticalExit(irq);
+	return status;
+}
+// zero-copy: q carries pointers (msgSize sizeof(void *)) to blocks the sender gives up,
+// the receiver owns the block until it frees it or passes it on
+osStatus_t send_msgq_ptr(msgq_t *q, void *block, uint32_t timeout)
+{
+	return send_msgq(q, &block, timeout);
+}
+osStatus_t recv_msgq_ptr(msgq_t *q, void **block, uint32_t timeout)
+{
+	return recv_msgq(q, block, timeout);
+}
+
+// carve buf into numBlocks blocks of blockSize bytes, see OS_POOL
+void init_pool(pool_t *p, void *buf, uint32_t blockSize, uint32_t numBlocks)
+{
+	uint32_t *block = buf;
+	
+	p -> blockSize = (blockSize + 3) & ~3u;
+	if (p -> blockSize < sizeof(void *))
+		p -> blockSize = sizeof(void *);
+	p -> numBlocks = numBlocks;
+	p -> used = 0;
+	p -> highWater = 0;
+	p -> freeList = NULL;
+	waitq_init(&p -> wait);
+	for (uint32_t i = numBlocks; i > 0; i--)
+	{
+		void **b = (void **)(block + (i - 1) * p -> blockSize / 4);
+		*b = p -> freeList;
+		p -> freeList = b;
+	}
+}
+// pop the free list head with LDREX/STREX, interrupts stay on. A single core cannot see ABA:
+// any other pop or push in between is an exception, which fails the STREX
+static void *poolPop(pool_t *p)
+{
+	volatile uint32_t *head = (volatile uint32_t *)&p -> freeList;
+	void **block;
+	
+	do {
+		block = (void **)__LDREXW(head);
+		if (block == NULL)
+		{
+			__CLREX();
+			return NULL;
+		}
+	} while (__STREXW((uint32_t)*block, head) != 0);
+	atomicMax(&p -> highWater, atomicAdd(&p -> used, 1));
+	return block;
+}
+// O(1) and lock-free unless the pool is empty, safe from an ISR with timeout 0.
+// Otherwise waits up to timeout for a block, returns NULL if none came
+void *alloc_pool(pool_t *p, uint32_t timeout)
+{
+	void *block = poolPop(p);
+	if (block != NULL || timeout == 0)
+		return block;
+	
+	uint32_t irq = osCriticalEnter();
+	block = poolPop(p);
+	if (block == NULL)
+	{
+		blockOn(&p -> wait, timeout);
+		osCriticalExit(irq);
+		irq = osCriticalEnter();
+		if (currentTask -> waitStatus == OS_OK)
+			block = currentTask -> msgPtr;
+	}
+	osCriticalExit(irq);
+	return block;
+}
+// push block back lock-free, or hand it straight to the highest waiter if a task is blocked
+// on the pool. Safe from an ISR
+void free_pool(pool_t *p, void *block)
+{
+	volatile uint32_t *head = (volatile uint32_t *)&p -> freeList;
+	
+	for (;;)
+	{
+		*(void **)block = (void *)__LDREXW(head);
+		if (p -> wait.size == 0)
+		{
+			if (__STREXW((uint32_t)block, head) == 0)
+				break;
+			continue;
+		}
+		__CLREX();
+		uint32_t irq = osCriticalEnter();
+		TCB_t *t = waitq_pop(&p -> wait);
+		if (t != NULL)
+		{
+			t -> msgPtr = block;
+			wakeWaiter(t, OS_OK);
+			osCriticalExit(irq);
+			return;
+		}
+		osCriticalExit(irq);
+	}
+	atomicAdd(&p -> used, -1);
+}
+
+// direct-to-task notification: update t's notification value and wake t if it is waiting.
+// No kernel object and no wait queue, the waiter is known. Safe from an ISR
+void osThreadNotify(TCB_t *t, uint32_t bits, notifyAction_t action)
+{
+	uint32_t irq = osCriticalEnter();
+	if (action == NOTIFY_INCREMENT)
+		t -> notifyValue++;
+	else if (action == NOTIFY_OVERWRITE)
+		t -> notifyValue = bits;
+	else
+		t -> notifyValue |= bits;
+	t -> notifyPending = true;
+	if (t -> notifyWaiting)
+	{
+		t -> notifyWaiting = false;
+		wakeWaiter(t, OS_OK);
+	}
+	osCriticalExit(irq);
+}
+// wait until a notification is pending for the caller, call inside the critical section
+// entered with *irq, which is left and re-entered around the block
+static osStatus_t notifyBlock(uint32_t *irq, uint32_t timeout)
+{
+	if (currentTask -> notifyPending)
+		return OS_OK;
+	if (timeout == 0)
+		return OS_TIMEOUT;
+	currentTask -> notifyWaiting = true;
+	blockSelf(timeout);
+	osCriticalExit(*irq);
+	*irq = osCriticalEnter();
+	return currentTask -> waitStatus;
+}
+// wait for a notification to the caller, *value gets the notification value before the bits
+// in clearOnExit are cleared, 0xFFFFFFFF makes it a binary semaphore. The wait is over either
+// way, use osThreadNotifyTake to count NOTIFY_INCREMENT notifications down one at a time
+osStatus_t osThreadNotifyWait(uint32_t clearOnExit, uint32_t timeout, uint32_t *value)
+{
+	uint32_t irq = osCriticalEnter();
+	osStatus_t status = notifyBlock(&irq, timeout);
+	if (status == OS_OK)
+	{
+		if (value != NULL)
+			*value = currentTask -> notifyValue;
+		currentTask -> notifyValue &= ~clearOnExit;
+		currentTask -> notifyPending = false;
+	}
+	osCriticalExit(irq);
+	return status;
+}
+// take one NOTIFY_INCREMENT notification, the counting semaphore use: the value is decremented
+// and stays pending while it is above zero. *count gets the value before the decrement
+osStatus_t osThreadNotifyTake(uint32_t timeout, uint32_t *count)
+{
+	uint32_t irq = osCriticalEnter();
+	osStatus_t status = notifyBlock(&irq, timeout);
+	if (status == OS_OK)
+	{
+		if (count != NULL)
+			*count = currentTask -> notifyValue;
+		if (currentTask -> notifyValue != 0)
+			currentTask -> notifyValue--;
+		currentTask -> notifyPending = (currentTask -> notifyValue != 0);
+	}
+	osCriticalExit(irq);
+	return status;
+}
+
+void init_mtx(mutex_t *mtx)
+{
+	mtx -> owner = NULL;
+	waitq_init(&mtx -> wait);
+	mtx -> nextHeld = NULL;
+	mtx -> linked = false;
+	mtx -> protocol = PRIO_INHERIT;
+	mtx -> ceiling = 0;
+}
+// immediate priority ceiling: ceiling must be at least the priority of every task locking mtx,
+// then a holder can never be preempted by another user, acquire never waits and nested
+// ceiling mutexes cannot deadlock. Blocking is bounded by the longest section of a lower task
+void init_mtx_ceiling(mutex_t *mtx, priority_t ceiling)
+{
+	init_mtx(mtx);
+	mtx -> protocol = PRIO_CEILING;
+	mtx -> ceiling = ceiling;
+}
+// put mtx on its owner's held list so prioRestore sees its waiters and ceiling
+// call with interrupts disabled
+void mtxLink(mutex_t *mtx)
+{
+	if (!mtx -> linked)
+	{
+		mtx -> nextHeld = mtx -> owner -> heldMutexes;
+		mtx -> owner -> heldMutexes = mtx;
+		mtx -> linked = true;
+	}
+}
+// uncontended fast path: claim a free PRIO_INHERIT mutex with LDREX/STREX and interrupts on.
+// Another task can only get in between through an exception, which clears the exclusive
+// monitor and fails the STREX, so the loop retries rather than racing the kernel path.
+// The mutex goes on the held list only when a waiter arrives, see mtxLink
+static __inline bool mtxTryFast(mutex_t *mtx)
+{
+	volatile uint32_t *word = (volatile uint32_t *)&mtx -> owner;
+	
+	if (mtx -> protocol != PRIO_INHERIT)
+		return false;
+	while (__LDREXW(word) == 0)
+	{
+		if (__STREXW((uint32_t)currentTask, word) == 0)
+			return true;
+	}
+	__CLREX();
+	return false;
+}
+osStatus_t acquire_timeout(mutex_t *mtx, uint32_t timeout)
+{
+	osStatus_t status = OS_OK;
+	if (mtxTryFast(mtx))
+		return OS_OK;
+	
+	uint32_t irq = osCriticalEnter();
+	if (mtx -> owner != NULL && timeout == 0)
+	{
+		status = OS_TIMEOUT;
+	}
+	else if (mtx -> owner != NULL)
+	{
+		// mtx has another owner, lend it our priority and wait to be handed the mutex
+		osLog(LOG_MTX_BLOCK, 0, 0, 0);
+		mtxLink(mtx);
+		prioInherit(mtx -> owner, currentTask -> priority);
+		#if SCHED_EDF
+		deadlineInherit(mtx -> owner, currentTask);
+		#endif
+		currentTask -> blockedOn = mtx;
+		blockOn(&mtx -> wait, timeout);
+		osCriticalExit(irq);
+		irq = osCriticalEnter();
+		status = currentTask -> waitStatus;
+	}
+	else
+	{
+		// can acquire, a ceiling mutex raises us at once without touching the wait queue
+		mtx -> owner = currentTask;
+		if (mtx -> protocol == PRIO_CEILING)
+		{
+			mtxLink(mtx);
+			if (mtx -> ceiling > currentTask -> priority)
+				setPriority(currentTask, mtx -> ceiling);
+		}
+		osLog(LOG_MTX_ACQ, 0, 0, 0);
+	}
+	osCriticalExit(irq);
+	return status;
+}
+void acquire(mutex_t *mtx)
+{
+	acquire_timeout(mtx, OS_WAIT_FOREVER);
+}
+// uncontended fast path: an unlinked mutex has never had a waiter during this hold, so it
+// lent no priority and can simply be cleared. A waiter arriving sets linked from an exception,
+// which fails the STREX, and the retry then sees it and falls through to the kernel path
+static __inline bool mtxReleaseFast(mutex_t *mtx)
+{
+	volatile uint32_t *word = (volatile uint32_t *)&mtx -> owner;
+	
+	while (__LDREXW(word) == (uint32_t)currentTask && !mtx -> linked)
+	{
+		if (__STREXW(0, word) == 0)
+			return true;
+	}
+	__CLREX();
+	return false;
+}
+void release(mutex_t *mtx)
+{
+	if (mtxReleaseFast(mtx))
+		return;
+	
+	uint32_t irq = osCriticalEnter();
+	if (mtx -> owner == currentTask)
+	{
+		// is owner, can release
+		osLog(LOG_MTX_REL, 0, 0, 0);
+		if (mtx -> linked)
+		{
+			mutex_t **link = &currentTask -> heldMutexes;
+			while (*link != mtx)
+				link = &(*link) -> nextHeld;
+			*link = mtx -> nextHeld;
+			mtx -> linked = false;
+		}
+		
+		// hand the mutex straight to the highest waiter, it inherits from the ones still waiting
+		TCB_t *next = waitq_pop(&mtx -> wait);
+		mtx -> owner = next;
+		if (next != NULL)
+		{
+			next -> blockedOn = NULL;
+			if (mtx -> protocol == PRIO_CEILING || mtx -> wait.size > 0)
+				mtxLink(mtx);
+			if (mtx -> protocol == PRIO_CEILING)
+				prioInherit(next, mtx -> ceiling);
+			if (mtx -> wait.size > 0)
+				prioInherit(next, waitq_top(&mtx -> wait));
+			#if SCHED_EDF
+			deadlineRestore(next);		// lent by the waiters still queued
+			#endif
+			wakeWaiter(next, OS_OK);
+		}
+		prioRestore(currentTask);
+		#if PREEMPT_ON_WAKE
+		schedule();				// the waiter may only outrank us once the boost is gone
+		#endif
+	}
+	else if (mtx -> owner == NULL)
+	{
+		// mtx not owned
+		osLog(LOG_MTX_NO_OWNER, 0, 0, 0);
+	}
+	else
+	{
+		// not owner
+		osLog(LOG_MTX_NOT_OWNER, 0, 0, 0);
+	}
+	osCriticalExit(irq);
+}
+
+// a blocked task's timeout fired first: take it off its wait queue or notification wait, and if it was waiting for
+// a mutex let the owner chain drop the priority (and EDF deadline) it no longer lends
+void timeoutExpired(TCB_t *t)
+{
+	if (t -> waitq != NULL)
+		waitq_remove(t -> waitq, t);
+	t -> notifyWaiting = false;
+	t -> waitStatus = OS_TIMEOUT;
+	if (t -> blockedOn != NULL)
+	{
+		TCB_t *owner = t -> blockedOn -> owner;
+		t -> blockedOn = NULL;
+		while (owner != NULL)
+		{
+			if (!prioRestore(owner) || owner -> blockedOn == NULL)
+				break;
+			owner = owner -> blockedOn -> owner;
+		}
+	}
+}
+
+bool osKernelInitialize(void)
+{
+	// stacks are assigned by osThreadStart, the main stack is left to main() and the handlers
+	for(int task_id = 0; task_id<MAX_TASKS; task_id++)
+	{
+		TASKS[task_id].stack_addr = 0;
+		TASKS[task_id].task_id = task_id;
+		TASKS[task_id].state = INACTIVE;
+		TASKS[task_id].priority = IDLE;
+	}
+	num_tasks = 0;
+	stackPoolUsed = 0;
+	
+	for(int i = 0; i<NUM_PRIORITIES; i++)
+	{
+		queue_init(&priorityArray[i]);
+		timeSlice[i] = TIME_SLICE;
+	}
+	bitVector_init(&bitVector);
+	
+	return true;
+}
+
+// start a task on a caller-provided stack, declare it with OS_STACK() or OS_STACK_ALIGNED()
+TCB_t *osThreadStartStatic(rtosTaskFunc_t task, void *arg, priority_t priority, void *stack, uint32_t stackSize)
+{
+	if (num_tasks >= MAX_TASKS || stackSize < MIN_STACK_SIZE)
+		return NULL;
+	
+	osLog(LOG_THREAD_INIT, num_tasks, priority, stackSize);
+	TCB_t *current_task = &TASKS[num_tasks];
+	
+	current_task -> priority = priority;
+	current_task -> basePriority = priority;
+	
+	// full descending stack, stack_addr starts at the top word with the frame 8-byte aligned
+	current_task -> stack_addr = (((uint32_t)stack + stackSize) & ~7u) - sizeof(uint32_t);
+	
+	uint32_t *PSR = (uint32_t *)(current_task -> stack_addr);
+	uint32_t *R0 = (uint32_t *)(current_task -> stack_addr - 7*sizeof(uint32_t));
+	uint32_t *PC = (uint32_t *)(current_task -> stack_addr - sizeof(uint32_t));
+	
+	*PSR = 0x01000000;
+	
+	*PC = (uint32_t)(task);
+	
+	*R0 = (uint32_t)(arg);
+	
+	// populate R4-R11
+	for (int i = 0; i<8; i++)
+	{
+		// i = 0,1,2,3,4,5,6,7
+		uint32_t *curr = (uint32_t *)(current_task ->stack_addr - (15-i)*sizeof(uint32_t));
+		
+		*curr = 0xAB000001 + num_tasks;
+	}
+	
+	for (int i = 9; i<14; i++)
+	{
+		uint32_t *curr = (uint32_t *)(current_task -> stack_addr - (15-i)*sizeof(uint32_t));
+		
+		*curr = 0xFFFF0001 + num_tasks;
+	}
+	
+	current_task -> stack_addr -= 15*4;
+	
+	wakeTask(current_task);
+	
+	num_tasks++;
+	return current_task;
+}
+
+// start a task with stackSize bytes carved from stackPool
+TCB_t *osThreadStart(rtosTaskFunc_t task, void *arg, priority_t priority, uint32_t stackSize)
+{
+	stackSize = (stackSize + 7) & ~7u;
+	if (num_tasks >= MAX_TASKS || stackPoolUsed + stackSize > STACK_POOL_SIZE)
+		return NULL;
+	
+	TCB_t *t = osThreadStartStatic(task, arg, priority, (uint8_t *)stackPool + stackPoolUsed, stackSize);
+	if (t != NULL)
+		stackPoolUsed += stackSize;
+	return t;
+}
+
+// start a periodic task released every period ticks with a relative deadline, the task body
+// calls osWaitNextPeriod() after each job. Under fixed priority only priority is used
+TCB_t *osThreadStartPeriodic(rtosTaskFunc_t task, void *arg, priority_t priority, uint32_t period, uint32_t deadline, uint32_t stackSize)
+{
+	uint32_t irq = osCriticalEnter();
+	TCB_t *t = osThreadStart(task, arg, priority, stackSize);
+	if (t != NULL)
+	{
+		// the key must be set before the task is placed in the ready set
+		readyRemove(t);
+		t -> period = period;
+		t -> relDeadline = deadline;
+		t -> release = msTicks;
+		t -> absDeadline = msTicks + deadline;
+		wakeTask(t);			// preempts the caller at once if the new job is more urgent
+	}
+	osCriticalExit(irq);
+	return t;
+}
+
+sem_t sem;
+mutex_t mtx;
+mutex_t printMtx;
+
+// demo output, a line at a time. A task holds printMtx and waits on the UART ring when it
+// is full, the idle task cannot wait so it prints from a critical section and the driver polls
+void demoPrintf(const char *fmt, ...)
+{
+	va_list args;
+	uint32_t irq;
+	
+	va_start(args, fmt);
+	if (osCanBlock())
+	{
+		acquire(&printMtx);
+		vprintf(fmt, args);
+		release(&printMtx);
+	}
+	else
+	{
+		irq = osCriticalEnter();
+		vprintf(fmt, args);
+		osCriticalExit(irq);
+	}
+	va_end(args);
+}
+
+#if TICKLESS_IDLE
+bool onlyIdleReady(void)
+{
+	#if SCHED_EDF
+	return readyHeapSize == 1;
+	#else
+	return bitVector_highest(&bitVector) == IDLE && priorityArray[IDLE].size == 1;
+	#endif
+}
+
+// called by the idle task: if nothing else is ready, stretch the next SysTick period up to the
+// first sleeper's wake time (at most the 24-bit reload), sleep, then add the skipped ticks to msTicks
+// PRIMASK rather than BASEPRI here: an interrupt masked by BASEPRI does not end a WFI
+void idleTickless(void)
+{
+	__disable_irq();
+	
+	uint32_t ticks = SysTick_LOAD_RELOAD_Msk / tickReload;
+	if (sleepList != NULL && (int32_t)(sleepList -> wakeTick - msTicks) < (int32_t)ticks)
+		ticks = (int32_t)(sleepList -> wakeTick - msTicks) > 0 ? sleepList -> wakeTick - msTicks : 0;
+	
+	// a tick already pending or due next period gains nothing
+	if (readyFirst() != currentTask || !onlyIdleReady()
+		|| (SCB -> ICSR & SCB_ICSR_PENDSTSET_Msk) || ticks < 2
+		#if OS_LOG
+		|| logHead != logTail
+		#endif
+		)
+	{
+		__enable_irq();
+		return;
+	}
+	
+	// the first of the skipped ticks is what is left of the current period
+	SysTick -> CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	uint32_t load = SysTick -> VAL + tickReload * (ticks - 1);
+	SysTick -> LOAD = load;
+	SysTick -> VAL = 0;
+	SysTick -> CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick -> LOAD = tickReload - 1;			// periods after the long one are normal again
+	
+	__DSB();
+	__WFI();									// PRIMASK is set, so any interrupt wakes us without running
+	__ISB();
+	
+	uint32_t ctrl = SysTick -> CTRL;			// reading clears COUNTFLAG
+	if (ctrl & SysTick_CTRL_COUNTFLAG_Msk)
+	{
+		// ran to the end, the pending SysTick_Handler counts the last tick
+		msTicks += ticks - 1;
+	}
+	else
+	{
+		// another interrupt woke us early, count the tick boundaries already passed
+		// and restart the counter on the next boundary
+		SysTick -> CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+		uint32_t remaining = SysTick -> VAL;
+		msTicks += ticks - (remaining + tickReload - 1) / tickReload;
+		remaining %= tickReload;
+		SysTick -> LOAD = (remaining != 0 ? remaining : tickReload) - 1;
+		SysTick -> VAL = 0;
+		SysTick -> CTRL = ctrl | SysTick_CTRL_ENABLE_Msk;
+		SysTick -> LOAD = tickReload - 1;
+	}
+	
+	__enable_irq();
+}
+#endif
+
+#ifdef __DEADLINE
+uint32_t missesShown = 0;
+#endif
+
+#ifdef __EVENT
+// two producers set their own flag every few ticks: a consumer waits for both and clears them,
+// a monitor peeks at either without clearing and then backs off so it does not spin on them
+#define EVT_A	0x01
+#define EVT_B	0x02
+event_t evtDemo;
+
+void tEvtSet(void *arg)
+{
+	uint32_t flag = (uint32_t)arg;
+	
+	while(1)
+	{
+		osDelay(flag == EVT_A ? 3 : 5);
+		set_evt(&evtDemo, flag);
+	}
+}
+
+void tEvtWait(void *arg)
+{
+	uint8_t options = (uint8_t)(uint32_t)arg;
+	uint32_t flags;
+	
+	while(1)
+	{
+		if (wait_evt(&evtDemo, EVT_A | EVT_B, options, 20, &flags) == OS_OK)
+		{
+			demoPrintf("\nt%d %s %x @%d", currentTask -> task_id, options & EVT_WAIT_ALL ? "all" : "any", flags, msTicks);
+			if (options & EVT_NO_CLEAR)
+				osDelay(4);
+		}
+		else
+		{
+			demoPrintf("\nt%d timeout", currentTask -> task_id);
+		}
+	}
+}
+#endif
+
+void t0(void *arg)
+{
+	while(1)
+	{	
+		#ifdef __DEADLINE
+		// printing stalls the job set, so only report when a deadline was missed
+		if (TASKS[1].deadlineMisses + TASKS[2].deadlineMisses != missesShown)
+		{
+			missesShown = TASKS[1].deadlineMisses + TASKS[2].deadlineMisses;
+			demoPrintf("\nmisses t1 %d t2 %d", TASKS[1].deadlineMisses, TASKS[2].deadlineMisses);
+		}
+		#else
+		demoPrintf("\nIDLE");
+		#endif
+		
+		#if OS_LOG
+		osLogDrain();
+		#endif
+		
+		#if TICKLESS_IDLE
+		idleTickless();
+		#else
+		Delay(1);
+		#endif
+	}
+}
+
+void terminate()
+{
+	// drop out of the ready set and give up the CPU
+	uint32_t irq = osCriticalEnter();
+	readyRemove(currentTask);
+	currentTask -> state = TERMINATED;
+	schedule();
+	osCriticalExit(irq);
+}
+
+void t1(void *arg)
+{
+	while(1)
+	{
+		if (TASKS[1].state != TERMINATED)
+		{
+			
+			#ifdef __PRIO
+			acquire(&mtx);
+			for(int i = 0; i < 15; i++)
+			{
+				demoPrintf("\nt1");
+				osDelay(1);
+			}
+			release(&mtx);
+			terminate();
+			#endif
+			
+			#ifdef __MTX
+			acquire(&mtx);
+			demoPrintf("\nt1 has mtx");
+			release(&mtx);
+			#endif
+			
+			#ifdef __SEM
+			wait_sem(&sem);
+			demoPrintf("\nt1 has sem");
+			osDelay(5);
+			signal_sem(&sem);
+			#endif
+			
+			#ifdef __FPP
+			demoPrintf("\nt1 %d", fpp_count[1]);
+			fpp_count[1]--;
+			if (fpp_count[1] == 0)
+			{
+				terminate();
+			}
+			#endif
+			
+			#ifdef __CONTEXT
+			demoPrintf("\nt1");
+			#endif
+			
+			osDelay(1);
+		}
+	}
+}
+
+
+void t2(void *arg)
+{
+	while(1)
+	{
+		if (TASKS[2].state != TERMINATED)
+		{
+			
+			#ifdef __PRIO
+			demoPrintf("\nt2");
+			osDelay(1);
+			#endif
+			
+			#ifdef __MTX
+			osDelay(10);
+			release(&mtx);
+			#endif
+			
+			#ifdef __SEM
+			wait_sem(&sem);
+			demoPrintf("\nt2 has sem");
+			osDelay(5);
+			signal_sem(&sem);
+			#endif
+			
+			#ifdef __FPP
+			demoPrintf("\nt2 %d", fpp_count[2]);
+			fpp_count[2]--;
+			if (fpp_count[2] == 0)
+			{
+				terminate();
+			}
+			#endif
+			
+			#ifdef __CONTEXT
+			demoPrintf("\nt2");
+			#endif
+			
+			osDelay(1);
+		}
+	}
+}
+
+void t3(void *arg)
+{
+	while(1)
+	{
+		if (TASKS[3].state != TERMINATED)
+		{
+			
+			#ifdef __PRIO
+			acquire(&mtx);
+			for (int i = 0 ; i < 5; i++)
+			{
+				demoPrintf("\nt3 %d", i);
+				osDelay(1);
+			}
+			release(&mtx);
+			#endif
+			
+			#ifdef __FPP
+			demoPrintf("\nt3 %d", fpp_count[3]);
+			
+			fpp_count[3]--;
+			if (fpp_count[3] == 0)
+			{
+				terminate();
+			}
+			#endif
+			
+			osDelay(1);
+		}
+	}
+}
+
+void t4(void *arg)
+{
+	while(1)
+	{
+		if (TASKS[4].state != TERMINATED)
+		{
+			
+			#ifdef __FPP
+			demoPrintf("\nt4 %d", fpp_count[4]);
+			fpp_count[4]--;
+			if (fpp_count[4] == 0)
+			{
+				terminate();
+			}
+			#endif
+			
+			osDelay(1);
+		}
+	}
+}
+
+void t5(void *arg)
+{
+	while(1)
+	{
+		if (TASKS[5].state != TERMINATED)
+		{
+			
+			#ifdef __FPP
+			demoPrintf("\nt5 %d", fpp_count[5]);
+			fpp_count[5]--;
+			if (fpp_count[5] == 0)
+			{
+				terminate();
+			}
+			#endif
+			
+			osDelay(1);
+		}
+	}
+}
+
+#ifdef __DEADLINE
+// periodic job of arg ticks, the task set below is 2/5 + 4/7 = 97% utilisation:
+// rate monotonic (t1 HIGH, t2 NORMAL) preempts t2's first job at tick 5 so it ends at tick 8,
+// past its deadline at 7. With SCHED_EDF every deadline is met
+void tJob(void *arg)
+{
+	uint32_t cost = (uint32_t)arg;
+	
+	while(1)
+	{
+		burn(cost);
+		osWaitNextPeriod();
+	}
+}
+#endif
+
+#ifdef __BENCH_TICK
+// SysTick_Handler cost in DWT cycles with BENCH_TASKS ready tasks at NORMAL
+uint32_t benchTickCycles = 0;
+uint32_t benchTickMax = 0;
+uint32_t benchTickSum = 0;
+uint32_t benchTickCount = 0;
+
+void tBench(void *arg)
+{
+	while(1)
+	{
+		if (arg != NULL && benchTickCount >= 100)
+		{
+			// take the samples together, print after so the writer can wait on the UART
+			uint32_t irq = osCriticalEnter();
+			uint32_t avg = benchTickSum / benchTickCount, max = benchTickMax;
+			benchTickSum = 0;
+			benchTickCount = 0;
+			benchTickMax = 0;
+			osCriticalExit(irq);
+			demoPrintf("\n%d tasks: avg %d max %d cycles", BENCH_TASKS, avg, max);
+		}
+	}
+}
+#endif
+
+#ifdef __BENCH_PINGPONG
+// wake-to-run latency in DWT cycles: tPing stamps and signals, the higher tPong measures
+// build with PREEMPT_ON_WAKE 0 to see the one-tick latency of waiting for SysTick
+// BENCH_NOTIFY 1 signals with direct-to-task notifications instead of the two semaphores
+#define BENCH_NOTIFY	0
+sem_t semPing, semPong;
+TCB_t *taskPing, *taskPong;
+uint32_t benchWakeStamp = 0;
+uint32_t benchWakeMax = 0;
+uint32_t benchWakeSum = 0;
+uint32_t benchWakeCount = 0;
+
+void tPing(void *arg)
+{
+	while(1)
+	{
+		benchWakeStamp = DWT -> CYCCNT;
+		#if BENCH_NOTIFY
+		osThreadNotify(taskPong, 0, NOTIFY_INCREMENT);
+		osThreadNotifyWait(0xFFFFFFFF, OS_WAIT_FOREVER, NULL);
+		#else
+		signal_sem(&semPing);
+		wait_sem(&semPong);
+		#endif
+	}
+}
+
+void tPong(void *arg)
+{
+	while(1)
+	{
+		#if BENCH_NOTIFY
+		osThreadNotifyWait(0xFFFFFFFF, OS_WAIT_FOREVER, NULL);
+		#else
+		wait_sem(&semPing);
+		#endif
+		uint32_t latency = DWT -> CYCCNT - benchWakeStamp;
+		benchWakeSum += latency;
+		benchWakeCount++;
+		if (latency > benchWakeMax)
+			benchWakeMax = latency;
+		
+		if (benchWakeCount == 100)
+		{
+			demoPrintf("\nwake latency: avg %d max %d cycles", benchWakeSum / benchWakeCount, benchWakeMax);
+			benchWakeSum = 0;
+			benchWakeCount = 0;
+			benchWakeMax = 0;
+		}
+		#if BENCH_NOTIFY
+		osThreadNotify(taskPing, 0, NOTIFY_INCREMENT);
+		#else
+		signal_sem(&semPong);
+		#endif
+	}
+}
+#endif
+
+#ifdef __BENCH_MUTEX
+// uncontended acquire/release pair in DWT cycles, the LDREX/STREX fast path against a
+// ceiling mutex at the caller's own priority, which always takes the kernel path
+#define BENCH_PAIRS	1000
+mutex_t mtxFast, mtxKernel;
+
+uint32_t benchMutexPair(mutex_t *m)
+{
+	uint32_t start = DWT -> CYCCNT;
+	for (int i = 0; i < BENCH_PAIRS; i++)
+	{
+		acquire(m);
+		release(m);
+	}
+	return (DWT -> CYCCNT - start) / BENCH_PAIRS;
+}
+
+void tMutexBench(void *arg)
+{
+	while(1)
+	{
+		uint32_t fast = benchMutexPair(&mtxFast);
+		uint32_t kernel = benchMutexPair(&mtxKernel);
+		demoPrintf("\nacquire+release: fast %d kernel %d cycles", fast, kernel);
+		osDelay(TICK_HZ);
+	}
+}
+#endif
+
+#ifdef __BENCH_MSGQ
+// messages per second from a NORMAL sender to a HIGH receiver, each send hands the frame
+// straight to the waiting receiver. BENCH_ZERO_COPY 1 sends pointers to the frames instead
+#define BENCH_MSG_SIZE	64
+#define BENCH_QUEUE_LEN	8
+#define BENCH_ZERO_COPY	0
+#if BENCH_ZERO_COPY
+uint8_t benchFrames[BENCH_QUEUE_LEN + 2][BENCH_MSG_SIZE];	// queue plus one held at each end
+void *benchQueueBuf[BENCH_QUEUE_LEN];
+#else
+uint8_t benchQueueBuf[BENCH_QUEUE_LEN][BENCH_MSG_SIZE];
+#endif
+msgq_t benchQueue;
+uint32_t benchMessages = 0;
+
+void tSender(void *arg)
+{
+	#if BENCH_ZERO_COPY
+	uint32_t next = 0;
+	#else
+	uint8_t frame[BENCH_MSG_SIZE] = {0};
+	#endif
+	
+	while(1)
+	{
+		#if BENCH_ZERO_COPY
+		send_msgq_ptr(&benchQueue, benchFrames[next], OS_WAIT_FOREVER);
+		if (++next == BENCH_QUEUE_LEN + 2)
+			next = 0;
+		#else
+		frame[0]++;
+		send_msgq(&benchQueue, frame, OS_WAIT_FOREVER);
+		#endif
+	}
+}
+
+void tReceiver(void *arg)
+{
+	uint32_t reportAt = msTicks + TICK_HZ;
+	#if BENCH_ZERO_COPY
+	void *frame;
+	#else
+	uint8_t frame[BENCH_MSG_SIZE];
+	#endif
+	
+	while(1)
+	{
+		#if BENCH_ZERO_COPY
+		recv_msgq_ptr(&benchQueue, &frame, OS_WAIT_FOREVER);
+		#else
+		recv_msgq(&benchQueue, frame, OS_WAIT_FOREVER);
+		#endif
+		benchMessages++;
+		if ((int32_t)(msTicks - reportAt) >= 0)
+		{
+			demoPrintf("\n%d byte messages/s: %d", BENCH_ZERO_COPY ? (int)sizeof(void *) : BENCH_MSG_SIZE, benchMessages);
+			benchMessages = 0;
+			reportAt += TICK_HZ;
+		}
+	}
+}
+#endif
+
+#ifdef __BENCH_IRQLAT
+// worst interrupt latency in core clocks, read from timer counters that restart on their match.
+// TIMER0 sits above MAX_SYSCALL_PRIORITY and should not notice the kernel, TIMER1 sits at it
+// like any ISR that calls the kernel. Every second the pair of load tasks is switched on or off
+#define BENCH_TIMER0_PERIOD	10007	// coprime periods so the two interrupts drift across each other
+#define BENCH_TIMER1_PERIOD	10009
+volatile uint32_t benchLatUnmasked = 0;
+volatile uint32_t benchLatKernel = 0;
+volatile bool benchLoad = false;
+sem_t semLoad;
+
+void TIMER0_IRQHandler(void)
+{
+	uint32_t latency = LPC_TIM0 -> TC;
+	LPC_TIM0 -> IR = 1;
+	if (latency > benchLatUnmasked)
+		benchLatUnmasked = latency;
+}
+
+void TIMER1_IRQHandler(void)
+{
+	uint32_t latency = LPC_TIM1 -> TC;
+	LPC_TIM1 -> IR = 1;
+	if (latency > benchLatKernel)
+		benchLatKernel = latency;
+}
+
+void benchTimerStart(LPC_TIM_TypeDef *tim, IRQn_Type irq, uint32_t period, uint32_t priority)
+{
+	tim -> TCR = 2;						// hold in reset
+	tim -> PR = 0;
+	tim -> MR0 = period - 1;
+	tim -> MCR = 3;						// interrupt and reset on MR0
+	NVIC_SetPriority(irq, priority);
+	NVIC_EnableIRQ(irq);
+	tim -> TCR = 1;
+}
+
+// kernel load: hand a semaphore back and forth as fast as the two tasks can switch
+void tLoad(void *arg)
+{
+	while(1)
+	{
+		if (benchLoad)
+		{
+			signal_sem(&semLoad);
+			wait_sem_timeout(&semLoad, 1);
+		}
+		else
+		{
+			osDelay(1);
+		}
+	}
+}
+
+void tLatReport(void *arg)
+{
+	// timers count core clocks, SystemInit selects CCLK/1 for TIMER0 and TIMER1 before PLL0
+	// connects since a PCLKSEL write after that may not take (errata PCLKSELx.1)
+	benchTimerStart(LPC_TIM0, TIMER0_IRQn, BENCH_TIMER0_PERIOD, 0);
+	benchTimerStart(LPC_TIM1, TIMER1_IRQn, BENCH_TIMER1_PERIOD, MAX_SYSCALL_PRIORITY);
+	
+	while(1)
+	{
+		benchLatUnmasked = 0;
+		benchLatKernel = 0;
+		osDelay(TICK_HZ);
+		uint32_t unmasked = benchLatUnmasked;
+		uint32_t kernel = benchLatKernel;
+		demoPrintf("\nload %d: max latency above threshold %d, at threshold %d cycles", benchLoad, unmasked, kernel);
+		benchLoad = !benchLoad;
+	}
+}
+#endif
+
+#ifdef __BENCH_PRODCONS
+// CPU time left to a LOW background task while a HIGH consumer waits on a producer
+// that makes one item per tick, reported as background loop iterations per 100 ticks
+sem_t semItems;
+uint32_t benchBackgroundLoops = 0;
+
+void tProducer(void *arg)
+{
+	while(1)
+	{
+		osDelay(1);
+		signal_sem(&semItems);
+	}
+}
+
+void tConsumer(void *arg)
+{
+	while(1)
+	{
+		wait_sem(&semItems);
+	}
+}
+
+void tBackground(void *arg)
+{
+	uint32_t reportAt = msTicks + 100;
+	
+	while(1)
+	{
+		benchBackgroundLoops++;
+		if ((int32_t)(msTicks - reportAt) >= 0)
+		{
+			demoPrintf("\nbackground loops/100 ticks: %d", benchBackgroundLoops);
+			benchBackgroundLoops = 0;
+			reportAt += 100;
+		}
+	}
+}
+#endif
+
+void osKernelStart(void)
+{
+	uint32_t *vectorTable = 0x0;
+	uint32_t mainStack = vectorTable[0];
+	__set_MSP(mainStack);
+	
+	//Switch from MSP to PSP
+	__set_CONTROL(__get_CONTROL() | 0x02);
+	__set_PSP(TASKS[0].stack_addr);
+	
+	NVIC_SetPriority(PendSV_IRQn, 0xff);		// PendSV below everything
+	
+	currentTask = &TASKS[0];
+	readyTask = currentTask;
+	
+	printf("\n\nStarting...\n\n");
+	
+	#if defined(__BENCH_TICK) || defined(__BENCH_PINGPONG) || defined(__BENCH_MUTEX)
+	CoreDebug -> DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT -> CYCCNT = 0;
+	DWT -> CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	#endif
+	
+	tickReload = SystemCoreClock/TICK_HZ;
+	SysTick_Config(tickReload);
+	// SysTick changes kernel state so it sits at the syscall threshold. This has to follow
+	// SysTick_Config, which puts SysTick at the lowest priority
+	NVIC_SetPriority(SysTick_IRQn, MAX_SYSCALL_PRIORITY);
+	t0(NULL);
+}
+
+int t2Started = 0;
+int t3Started = 0;
+
+void SysTick_Handler(void) {
+	#ifdef __BENCH_TICK
+	benchTickCycles = DWT -> CYCCNT;
+	#endif
+	
+	uint32_t irq = osCriticalEnter();			// holds off other kernel-aware ISRs
+	msTicks++;
+	sysTickEntries++;
+	
+	#ifdef __PRIO
+	if (msTicks > 3 && !t2Started)
+	{
+		osThreadStart(t2,NULL,HIGH,TASK_STACK_SIZE);
+		t2Started = 1;
+	}
+	if (msTicks > 10 && !t3Started)
+	{
+		osThreadStart(t3,NULL,NORMAL,TASK_STACK_SIZE);
+		t3Started = 1;
+	}
+	#endif
+	
+	// wake sleepers and expire timeouts whose time has come, the list is sorted so only
+	// expired entries are touched
+	while (sleepList != NULL && (int32_t)(msTicks - sleepList -> wakeTick) >= 0)
+	{
+		TCB_t *woken = sleepList;
+		sleep_remove(woken);
+		if (woken -> state == BLOCKED)
+			timeoutExpired(woken);
+		readyEnqueue(woken);
+	}
+	
+	currentTask -> runTicks++;
+	
+	#if !SCHED_EDF
+	// round robin: charge the tick to the running task, once its slice is used up
+	// it gives the head of its level to the next one in line
+	if (currentTask -> state == READY && timeSlice[currentTask -> priority] != 0
+		&& !sliceExempt(currentTask) && --currentTask -> sliceLeft == 0)
+	{
+		queue_t *q = &priorityArray[currentTask -> priority];
+		currentTask -> sliceLeft = timeSlice[currentTask -> priority];
+		if (q -> head == currentTask && q -> size > 1)
+		{
+			enqueue(q, dequeue(q));
+		}
+	}
+	#endif
+	
+	schedule();
+	osCriticalExit(irq);
+	
+	#ifdef __BENCH_TICK
+	benchTickCycles = DWT -> CYCCNT - benchTickCycles;
+	benchTickSum += benchTickCycles;
+	benchTickCount++;
+	if (benchTickCycles > benchTickMax)
+		benchTickMax = benchTickCycles;
+	#endif
+}
+
+#ifndef __HOST_TEST
+// save the outgoing context straight into currentTask and load readyTask's in one pass
+// the hardware has already stacked R0-R3, R12, LR, PC and xPSR on the PSP
+__asm void PendSV_Handler(void)
+{
+	PRESERVE8
+	
+	MRS R0,PSP
+	STMFD R0!,{R4-R11}
+	
+	MOVS R2,#__cpp(OS_BASEPRI)
+	MSR BASEPRI,R2				; kernel-aware ISRs write readyTask, hold them off for the exchange
+	
+	LDR R3,=__cpp(&currentTask)
+	LDR R1,[R3]
+	STR R0,[R1]					; currentTask -> stack_addr = PSP
+	
+	LDR R2,=__cpp(&readyTask)
+	LDR R1,[R2]
+	STR R1,[R3]					; currentTask = readyTask
+	
+	MOVS R2,#0
+	MSR BASEPRI,R2				; PendSV only runs with BASEPRI clear
+	
+	LDR R0,[R1]					; PSP = readyTask -> stack_addr
+	LDMFD R0!,{R4-R11}
+	MSR PSP,R0
+	
+	BX		LR
+}
+#endif
+
+int main(void) {
+	// default code
+	printf("\n\n\n--- system init ---\n");
+	osKernelInitialize();
+	init_mtx(&printMtx);
+	osThreadStartStatic(t0,NULL,IDLE,idleStack,sizeof(idleStack));
+	
+	#ifdef __CONTEXT
+	// context switching, equal priority tasks take turns of three ticks
+	osSetTimeSlice(NORMAL, 3);
+	osThreadStart(t1,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(t2,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(t3,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __FPP
+	// FPP scheduling
+	osThreadStart(t1,NULL,HIGH,TASK_STACK_SIZE);
+	osThreadStart(t2,NULL,HIGH,TASK_STACK_SIZE);
+	osThreadStart(t3,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(t4,NULL,LOW,TASK_STACK_SIZE);
+	osThreadStart(t5,NULL,LOW,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __SEM
+	// blocking semaphores
+	init_sem(&sem,1);
+	osThreadStart(t1,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(t2,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __MTX
+	init_mtx(&mtx);
+	osThreadStart(t1,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(t2,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __PRIO
+	init_mtx(&mtx);
+	osThreadStart(t1,NULL,LOW,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __BENCH_TICK
+	// round robin cost at one priority level, the first task reports
+	for (int i = 0; i < BENCH_TASKS; i++)
+		osThreadStart(tBench, i == 0 ? (void *)1 : NULL, NORMAL, i == 0 ? TASK_STACK_SIZE : BENCH_STACK_SIZE);
+	#endif
+	
+	#ifdef __DEADLINE
+	osThreadStartPeriodic(tJob,(void *)2,HIGH,5,5,TASK_STACK_SIZE);
+	osThreadStartPeriodic(tJob,(void *)4,NORMAL,7,7,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __EVENT
+	init_evt(&evtDemo);
+	osThreadStart(tEvtWait,(void *)EVT_WAIT_ALL,HIGH,TASK_STACK_SIZE);
+	osThreadStart(tEvtWait,(void *)(EVT_WAIT_ANY | EVT_NO_CLEAR),ABOVE_NORMAL,TASK_STACK_SIZE);
+	osThreadStart(tEvtSet,(void *)EVT_A,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(tEvtSet,(void *)EVT_B,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __BENCH_PINGPONG
+	init_sem(&semPing,0);
+	init_sem(&semPong,0);
+	taskPong = osThreadStart(tPong,NULL,HIGH,TASK_STACK_SIZE);
+	taskPing = osThreadStart(tPing,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __BENCH_MUTEX
+	init_mtx(&mtxFast);
+	init_mtx_ceiling(&mtxKernel,NORMAL);
+	osThreadStart(tMutexBench,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __BENCH_MSGQ
+	#if BENCH_ZERO_COPY
+	init_msgq(&benchQueue,benchQueueBuf,sizeof(void *),BENCH_QUEUE_LEN);
+	#else
+	init_msgq(&benchQueue,benchQueueBuf,BENCH_MSG_SIZE,BENCH_QUEUE_LEN);
+	#endif
+	osThreadStart(tReceiver,NULL,HIGH,TASK_STACK_SIZE);
+	osThreadStart(tSender,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __BENCH_IRQLAT
+	init_sem(&semLoad,0);
+	osThreadStart(tLatReport,NULL,HIGH,TASK_STACK_SIZE);
+	osThreadStart(tLoad,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(tLoad,NULL,NORMAL,TASK_STACK_SIZE);
+	#endif
+	
+	#ifdef __BENCH_PRODCONS
+	init_sem(&semItems,0);
+	osThreadStart(tConsumer,NULL,HIGH,TASK_STACK_SIZE);
+	osThreadStart(tProducer,NULL,NORMAL,TASK_STACK_SIZE);
+	osThreadStart(tBackground,NULL,LOW,TASK_STACK_SIZE);
+	#endif
+	
+	osKernelStart();
+	
+}
@@ -0,0 +1,38 @@
+/*
+ * Deferred kernel log formats, shared by the target and tools/logdecode.py.
+ * A record carries only the position of its format in this table, so entries
+ * are appended, never reordered.
+ */
+#ifndef __OSLOG_H
+#define __OSLOG_H
+
+#include <stdint.h>
+
+// X(id, number of arguments, format), the host prints "<ms> t<task> " before the format
+#define OS_LOG_FORMATS(X) \
+	X(LOG_DROPPED,		1, "%d records dropped") \
+	X(LOG_SEM_REQ,		0, "req") \
+	X(LOG_SEM_WAIT,		0, "wait") \
+	X(LOG_SEM_REL,		0, "rel") \
+	X(LOG_MTX_BLOCK,	0, "block") \
+	X(LOG_MTX_ACQ,		0, "acq") \
+	X(LOG_MTX_REL,		0, "rel") \
+	X(LOG_MTX_NO_OWNER,	0, "no owner") \
+	X(LOG_MTX_NOT_OWNER,	0, "not owner") \
+	X(LOG_THREAD_INIT,	3, "init t%d p%d s%d")
+
+typedef enum {
+#define OS_LOG_ID(id, nargs, format)	id,
+	OS_LOG_FORMATS(OS_LOG_ID)
+#undef OS_LOG_ID
+	LOG_COUNT
+} logId_t;
+
+// a frame is 0xFF then the record packed six bits per byte as 0x80 | bits, so frame bytes
+// never collide with ASCII printf output sharing the port and the host can pull them apart
+#define LOG_FRAME_START	0xFF
+
+// raw byte to the stdout port without newline translation, Retarget.c
+int sendbyte(int c);
+
+#endif /* end __OSLOG_H */
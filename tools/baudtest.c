@@ -0,0 +1,59 @@
+/*
+ * Host check of the fractional baud divider search in uartbaud.h.
+ *
+ *     cc -std=c99 -Wall -o baudtest tools/baudtest.c && ./baudtest
+ *
+ * Exits non-zero if any case differs from the expected divisors.
+ */
+#include <stdio.h>
+#include "../uartbaud.h"
+
+typedef struct {
+	uint32_t pclk;
+	uint32_t baud;
+	uint32_t fits;			/* 0: no divisor setting exists */
+	uint16_t dl;
+	uint8_t divAddVal;
+	uint8_t mulVal;
+	uint32_t achieved;
+	int32_t errorPpm;
+} baudCase_t;
+
+static const baudCase_t cases[] = {
+	/* user manual worked examples: exact with DL alone, and 115384 baud (+0.16%) */
+	{ 14745600,   9600, 1, 96, 0, 1,   9600,     0 },
+	{ 12000000, 115200, 1,  4, 5, 8, 115385,  1603 },
+	/* PCLK = CCLK/4 and CCLK/1 at 100 MHz */
+	{ 25000000, 115200, 1, 10, 5, 14, 115132,  -594 },
+	{ 100000000, 115200, 1, 31, 3, 4, 115207,    64 },
+	{ 100000000, 1000000, 1, 5, 1, 4, 1000000,    0 },
+	/* the Retarget console rate at the PCLK SystemInit selects */
+	{ 100000000,   9600, 1, 514, 4, 15,  9600,   -38 },
+	/* far beyond pclk / 16, DL rounds to 0 */
+	{ 25000000, 4000000, 0, 0, 0, 0,      0,     0 },
+};
+
+int main(void)
+{
+	uint32_t i, failed = 0;
+
+	for ( i = 0; i < sizeof(cases) / sizeof(cases[0]); i++ )
+	{
+		const baudCase_t *c = &cases[i];
+		uartBaud_t b = { 0 };
+		uint32_t err = uartBaudSearch( c->pclk, c->baud, &b );
+		uint32_t ok;
+
+		if ( !c->fits )
+			ok = (err == 0xFFFFFFFF);
+		else
+			ok = err != 0xFFFFFFFF && b.dl == c->dl && b.divAddVal == c->divAddVal
+				&& b.mulVal == c->mulVal && b.baud == c->achieved && b.errorPpm == c->errorPpm;
+
+		printf( "%s %9u Hz %8u baud -> DL %u DIVADDVAL %u MULVAL %u, %u baud, %d ppm\n",
+			ok ? "ok  " : "FAIL", (unsigned)c->pclk, (unsigned)c->baud, (unsigned)b.dl,
+			(unsigned)b.divAddVal, (unsigned)b.mulVal, (unsigned)b.baud, (int)b.errorPpm );
+		failed += !ok;
+	}
+	return failed != 0;
+}
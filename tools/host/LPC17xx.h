@@ -0,0 +1,87 @@
+/*
+ * Host stand-in for the CMSIS device header, enough for tools/kerneltest.c to
+ * build main.c with gcc or clang. Registers are plain structs, the intrinsics
+ * are single threaded equivalents and nothing ever switches context: a task
+ * that blocks just returns, with readyTask showing who PendSV would run.
+ */
+#ifndef __HOST_LPC17XX_H
+#define __HOST_LPC17XX_H
+
+#include <stdint.h>
+
+#define __NVIC_PRIO_BITS	5
+#define __I		volatile const
+#define __O		volatile
+#define __IO	volatile
+#define zero_init	used		/* armcc ZI section attribute */
+
+typedef enum {
+	PendSV_IRQn = -2, SysTick_IRQn = -1,
+	TIMER0_IRQn = 1, TIMER1_IRQn = 2, UART0_IRQn = 5, UART1_IRQn = 6, UART2_IRQn = 7, UART3_IRQn = 8
+} IRQn_Type;
+
+typedef struct { __IO uint32_t ICSR; } SCB_Type;
+typedef struct { __IO uint32_t CTRL, LOAD, VAL, CALIB; } SysTick_Type;
+typedef struct { __IO uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { __IO uint32_t DEMCR; } CoreDebug_Type;
+typedef struct { __IO uint32_t PCLKSEL0, PCLKSEL1, PCONP; } LPC_SC_TypeDef;
+typedef struct { __IO uint32_t TCR, PR, MR0, MCR, IR, TC; } LPC_TIM_TypeDef;
+
+static SCB_Type hostScb;
+static SysTick_Type hostSysTick;
+static DWT_Type hostDwt;
+static CoreDebug_Type hostCoreDebug;
+static LPC_SC_TypeDef hostSc;
+static LPC_TIM_TypeDef hostTim[2];
+#define SCB			(&hostScb)
+#define SysTick		(&hostSysTick)
+#define DWT			(&hostDwt)
+#define CoreDebug	(&hostCoreDebug)
+#define LPC_SC		(&hostSc)
+#define LPC_TIM0	(&hostTim[0])
+#define LPC_TIM1	(&hostTim[1])
+
+#define SCB_ICSR_PENDSVSET_Msk		(1u << 28)
+#define SCB_ICSR_PENDSTSET_Msk		(1u << 26)
+#define SCB_ICSR_PENDSTCLR_Msk		(1u << 25)
+#define SysTick_LOAD_RELOAD_Msk		0xFFFFFFu
+#define SysTick_CTRL_ENABLE_Msk		1u
+#define SysTick_CTRL_TICKINT_Msk	2u
+#define SysTick_CTRL_CLKSOURCE_Msk	4u
+#define SysTick_CTRL_COUNTFLAG_Msk	(1u << 16)
+#define DWT_CTRL_CYCCNTENA_Msk		1u
+#define CoreDebug_DEMCR_TRCENA_Msk	(1u << 24)
+#define ITM_RXBUFFER_EMPTY			0x5AA55AA5
+
+static uint32_t SystemCoreClock = 100000000;
+static uint32_t hostBasepri, hostPrimask, hostIpsr, hostControl;
+
+static inline uint32_t __clz(uint32_t x) { return x == 0 ? 32 : (uint32_t)__builtin_clz(x); }
+static inline uint32_t __LDREXW(volatile void *p) { return *(volatile uint32_t *)p; }
+static inline uint32_t __STREXW(uint32_t v, volatile void *p) { *(volatile uint32_t *)p = v; return 0; }
+static inline void __CLREX(void) {}
+static inline void __DMB(void) {}
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+static inline void __WFI(void) {}
+static inline void __NOP(void) {}
+static inline uint32_t __get_BASEPRI(void) { return hostBasepri; }
+static inline void __set_BASEPRI(uint32_t v) { hostBasepri = v; }
+static inline uint32_t __get_PRIMASK(void) { return hostPrimask; }
+static inline void __disable_irq(void) { hostPrimask = 1; }
+static inline void __enable_irq(void) { hostPrimask = 0; }
+static inline uint32_t __get_IPSR(void) { return hostIpsr; }
+static inline uint32_t __get_CONTROL(void) { return hostControl; }
+static inline void __set_CONTROL(uint32_t v) { hostControl = v; }
+static inline void __set_MSP(uint32_t v) { (void)v; }
+static inline void __set_PSP(uint32_t v) { (void)v; }
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t p) { (void)irq; (void)p; }
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { (void)irq; }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { (void)irq; }
+static inline void NVIC_SetPendingIRQ(IRQn_Type irq) { (void)irq; }
+static inline uint32_t SysTick_Config(uint32_t ticks) { (void)ticks; return 0; }
+static inline uint32_t ITM_SendChar(uint32_t c) { return c; }
+static inline int32_t ITM_ReceiveChar(void) { return -1; }
+static inline int32_t ITM_CheckChar(void) { return 0; }
+
+#endif /* __HOST_LPC17XX_H */
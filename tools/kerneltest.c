@@ -0,0 +1,132 @@
+/*
+ * Host checks of the kernel queues, built from main.c itself:
+ *
+ *     cc -std=c99 -fno-pie -no-pie -Itools/host -o kerneltest tools/kerneltest.c && ./kerneltest
+ *
+ * The kernel keeps addresses in 32 bit words, a position dependent image keeps
+ * them below 4 GB on a 64 bit host. There is no context switch on the host. A task that blocks returns at once,
+ * readyTask shows what PendSV would run and pendSV() below makes the switch.
+ * Exits non-zero if any check fails.
+ */
+#define __HOST_TEST
+#define main kernelMain
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"		/* 32 bit words holding addresses */
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+#include "../main.c"
+#undef main
+
+static int failures;
+static sem_t sem1;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+// the deferred log drains through Retarget.c on the target
+int sendbyte(int c)
+{
+	return c;
+}
+
+static void taskBody(void *arg)
+{
+	(void)arg;
+}
+
+// what PendSV does once the kernel lets it run
+static void pendSV(void)
+{
+	if (SCB -> ICSR & SCB_ICSR_PENDSVSET_Msk)
+	{
+		SCB -> ICSR = 0;
+		currentTask = readyTask;
+	}
+}
+
+// idle plus two NORMAL tasks, the first one running
+static void startTwo(TCB_t **a, TCB_t **b)
+{
+	osKernelInitialize();
+	osThreadStartStatic(t0, NULL, IDLE, idleStack, sizeof(idleStack));
+	*a = osThreadStart(taskBody, NULL, NORMAL, TASK_STACK_SIZE);
+	*b = osThreadStart(taskBody, NULL, NORMAL, TASK_STACK_SIZE);
+	currentTask = readyTask = *a;
+	SCB -> ICSR = 0;
+}
+
+// a task blocking while a peer is ready at its level must leave the peer queued
+static void testBlockWithPeer(void)
+{
+	TCB_t *a, *b;
+
+	startTwo(&a, &b);
+	init_sem(&sem1, 0);
+	wait_sem_timeout(&sem1, OS_WAIT_FOREVER);
+
+	CHECK(a -> state == BLOCKED);
+	CHECK(priorityArray[NORMAL].size == 1);
+	CHECK(priorityArray[NORMAL].head == b);
+	CHECK(priorityArray[NORMAL].tail == b);
+	CHECK(readyFirst() == b);
+	CHECK(readyTask == b);
+	CHECK(sem1.wait.size == 1 && sem1.wait.bucket[NORMAL] == a);
+
+	pendSV();
+	signal_sem(&sem1);
+
+	CHECK(a -> state == READY && a -> waitStatus == OS_OK);
+	CHECK(sem1.wait.size == 0 && sem1.wait.bucket[NORMAL] == NULL);
+	CHECK(priorityArray[NORMAL].size == 2);
+	CHECK(priorityArray[NORMAL].head == b && priorityArray[NORMAL].tail == a);
+	CHECK(readyTask == b);
+}
+
+// highest level first, FIFO within a level, removal from any position
+static void testWaitqOrder(void)
+{
+	static TCB_t t[5];
+	waitq_t w;
+	int i;
+
+	waitq_init(&w);
+	for (i = 0; i < 5; i++)
+		t[i].priority = (i == 2) ? HIGH : NORMAL;
+	for (i = 0; i < 5; i++)
+		waitq_insert(&w, &t[i]);
+
+	CHECK(w.size == 5 && waitq_top(&w) == HIGH);
+	waitq_remove(&w, &t[4]);			// tail of NORMAL
+	waitq_remove(&w, &t[1]);			// middle of NORMAL
+	waitq_insert(&w, &t[4]);			// appends behind t[3]
+
+	CHECK(waitq_pop(&w) == &t[2]);
+	CHECK(waitq_pop(&w) == &t[0]);
+	CHECK(waitq_pop(&w) == &t[3]);
+	CHECK(waitq_pop(&w) == &t[4]);
+	CHECK(waitq_pop(&w) == NULL);
+	CHECK(w.size == 0 && w.levels.group == 0);
+}
+
+// NOTIFY_INCREMENT counts down one take at a time
+static void testNotifyCount(void)
+{
+	TCB_t *a, *b;
+	uint32_t count;
+
+	startTwo(&a, &b);
+	osThreadNotify(a, 0, NOTIFY_INCREMENT);
+	osThreadNotify(a, 0, NOTIFY_INCREMENT);
+
+	CHECK(osThreadNotifyTake(0, &count) == OS_OK && count == 2);
+	CHECK(osThreadNotifyTake(0, &count) == OS_OK && count == 1);
+	CHECK(osThreadNotifyTake(0, &count) == OS_TIMEOUT);
+	CHECK(a -> state == READY && readyTask == a);
+}
+
+int main(void)
+{
+	testBlockWithPeer();
+	testWaitqOrder();
+	testNotifyCount();
+	printf("%s\n", failures ? "kerneltest: FAILED" : "kerneltest: ok");
+	return failures != 0;
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Expand the deferred kernel log on the host.
+
+Reads a capture of the stdout port (file or stdin) and writes it back out with
+every log frame replaced by a text line. Plain printf output passes through.
+Log frames can interleave with it byte by byte, because frame bytes always
+have bit 7 set and ASCII never does.
+
+    python3 tools/logdecode.py [capture.bin] [--formats oslog.h]
+"""
+import argparse
+import os
+import re
+import sys
+
+FRAME_START = 0xFF
+
+
+def load_formats(path):
+    text = open(path).read()
+    return [(int(n), fmt.encode().decode("unicode_escape"))
+            for n, fmt in re.findall(r'X\(\s*\w+\s*,\s*(\d+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', text)]
+
+
+def unpack(chunks):
+    bits = 0
+    held = 0
+    out = bytearray()
+    for c in chunks:
+        bits |= (c & 0x3F) << held
+        held += 6
+        if held >= 8:
+            out.append(bits & 0xFF)
+            bits >>= 8
+            held -= 8
+    return bytes(out)
+
+
+def expand(frame, formats):
+    data = unpack(frame)
+    if len(data) < 6 or data[0] >= len(formats):
+        return "<bad log frame %s>" % data.hex()
+    nargs, fmt = formats[data[0]]
+    task = data[1]
+    time = int.from_bytes(data[2:6], "little")
+    if len(data) < 6 + 4 * nargs:
+        return "<short log frame %s>" % data.hex()
+    args = tuple(int.from_bytes(data[6 + 4 * i:10 + 4 * i], "little", signed=True)
+                 for i in range(nargs))
+    who = "--" if task == 0xFF else "t%d" % task
+    return "%8d %s %s" % (time, who, fmt % args)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("capture", nargs="?", help="raw port capture, stdin if omitted")
+    ap.add_argument("--formats", default=os.path.join(here, "..", "oslog.h"))
+    opts = ap.parse_args()
+
+    formats = load_formats(opts.formats)
+    raw = open(opts.capture, "rb").read() if opts.capture else sys.stdin.buffer.read()
+
+    out = bytearray()
+    frame = None
+    for b in raw:
+        if b == FRAME_START:
+            if frame:
+                out.extend(b"\n[log] " + expand(frame, formats).encode())
+            frame = []
+        elif b & 0x80:
+            if frame is None:
+                continue
+            frame.append(b)
+            # a frame is complete once it holds the bytes its format needs
+            if len(frame) >= 2:
+                rid = unpack(frame[:2])[0]
+                size = 6 + 4 * (formats[rid][0] if rid < len(formats) else 0)
+                if len(frame) >= (size * 8 + 5) // 6:
+                    out.extend(b"\n[log] " + expand(frame, formats).encode())
+                    frame = None
+        else:
+            out.append(b)
+    if frame:
+        out.extend(b"\n[log] " + expand(frame, formats).encode())
+    sys.stdout.buffer.write(bytes(out) + b"\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,46 +1,192 @@
-#include <LPC17xx.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-
-typedef void (*rtosTaskFunc_t)(void *args);
-typedef uint8_t bitVector_t;
-
-typedef enum{
-	READY = 0,
-	RUNNING = 1,
-	BLOCKED = 2,
-	INACTIVE = 3,
-	TERMINATED = 4
-} state_t;
-
-typedef enum{
-	IDLE = 0x00,
-	LOW = 0x1,
-	NORMAL = 0x2,
-	ABOVE_NORMAL = 0x3,
-	HIGH = 0x4
-}priority_t;
-
-typedef struct TCB{
-	uint8_t task_id;
-	state_t state;
-	uint32_t stack_addr;
-	priority_t priority;
-	priority_t oldPriority;
-	struct TCB *next;
-} TCB_t;
-
-typedef struct queue{
-	TCB_t *head;
-	uint32_t size;
-}queue_t;
-
-typedef struct sem {
-	int32_t s;
-	queue_t wait;
-} sem_t;
-typedef struct mutex{
-	sem_t m;
-	uint8_t owner;
-}mutex_t;
+#ifndef __TYPES_C
+#define __TYPES_C
+
+#include <LPC17xx.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// number of priority levels, 0 is the lowest, up to 256 (override with -DNUM_PRIORITIES=n)
+#ifndef NUM_PRIORITIES
+#define NUM_PRIORITIES 32
+#endif
+#if NUM_PRIORITIES < 1 || NUM_PRIORITIES > 256
+#error "NUM_PRIORITIES must be between 1 and 256"
+#endif
+#define NUM_PRIO_GROUPS ((NUM_PRIORITIES + 31) / 32)
+
+// NVIC priority (0 highest .. 31) kernel critical sections mask up to, ISRs numerically below it
+// are never held off and must not call the kernel. Drivers calling the kernel (uart.c) sit at it
+#ifndef MAX_SYSCALL_PRIORITY
+#define MAX_SYSCALL_PRIORITY	4
+#endif
+
+// kernel critical section: raise BASEPRI so only ISRs at MAX_SYSCALL_PRIORITY or below wait,
+// the previous level comes back on exit so sections nest and work from ISRs too
+#define OS_BASEPRI	(MAX_SYSCALL_PRIORITY << (8 - __NVIC_PRIO_BITS))
+static __inline uint32_t osCriticalEnter(void)
+{
+	uint32_t basepri = __get_BASEPRI();
+	if (basepri == 0 || basepri > OS_BASEPRI)
+		__set_BASEPRI(OS_BASEPRI);
+	return basepri;
+}
+static __inline void osCriticalExit(uint32_t basepri)
+{
+	__set_BASEPRI(basepri);
+	__ISB();						// a PendSV the section left pending is taken here
+}
+
+typedef void (*rtosTaskFunc_t)(void *args);
+
+// two-level bitmap of non-empty priority levels
+// bit g of group is set while leaf[g] != 0, bit p%32 of leaf[p/32] while level p is non-empty
+typedef struct bitVector{
+	uint32_t group;
+	uint32_t leaf[NUM_PRIO_GROUPS];
+} bitVector_t;
+
+// result of a blocking call, also kept in the TCB while the task waits
+typedef enum{
+	OS_OK = 0,
+	OS_WAITING = 1,
+	OS_TIMEOUT = 2
+} osStatus_t;
+
+#define OS_WAIT_FOREVER	0xFFFFFFFFu	// timeout that never expires, 0 polls without blocking
+
+// the running task is READY as well, currentTask tells it apart
+typedef enum{
+	READY = 0,
+	RUNNING = 1,
+	BLOCKED = 2,
+	INACTIVE = 3,
+	TERMINATED = 4,
+	SLEEPING = 5
+} state_t;
+
+// any level 0..NUM_PRIORITIES-1 is valid, the names are kept for the demo tasks
+typedef uint8_t priority_t;
+enum{
+	IDLE = 0x00,
+	LOW = 0x1,
+	NORMAL = 0x2,
+	ABOVE_NORMAL = 0x3,
+	HIGH = 0x4
+};
+
+typedef struct TCB{
+	uint32_t stack_addr;		// must stay first, PendSV_Handler saves and loads it at offset 0
+	uint8_t task_id;
+	state_t state;
+	priority_t priority;
+	priority_t basePriority;	// assigned level, priority may be raised above it by inheritance
+	struct mutex *heldMutexes;	// mutexes owned, linked through nextHeld
+	struct mutex *blockedOn;	// mutex the task waits for, NULL otherwise
+	osStatus_t waitStatus;		// set by whoever wakes a BLOCKED task
+	struct waitq *waitq;		// wait queue a BLOCKED task is on
+	struct TCB *next;
+	struct TCB *prev;
+	uint8_t sliceLeft;			// round robin ticks left, reloaded when the task is queued or rotated
+	uint32_t wakeTick;			// msTicks value a SLEEPING task is readied at, or a BLOCKED one times out
+	struct TCB *sleepNext;		// sleep list links, separate from next/prev
+	struct TCB *sleepPrev;
+	volatile uint32_t runTicks;	// ticks charged to the task
+	uint32_t period;			// periodic tasks only, see osThreadStartPeriodic
+	uint32_t relDeadline;		// 0 for tasks without a deadline
+	uint32_t release;			// release tick of the current job
+	uint32_t absDeadline;		// release + relDeadline, the EDF key
+	uint32_t lentDeadline;		// earliest deadline of a waiter on a mutex held, see deadlineInherit
+	bool deadlineLent;			// lentDeadline is in force
+	uint32_t deadlineMisses;
+	uint8_t heapIndex;			// position in readyHeap under SCHED_EDF
+	uint32_t eventFlags;		// flags waited for on an event group, the flags that woke the task after
+	uint8_t eventOptions;		// EVT_WAIT_ALL / EVT_NO_CLEAR of that wait
+	void *msgPtr;				// message a task blocked on a queue sends from or receives into, or the pool block it was handed
+	volatile uint32_t notifyValue;	// direct-to-task notification, see osThreadNotify
+	volatile bool notifyPending;
+	bool notifyWaiting;			// BLOCKED in osThreadNotifyWait rather than on a wait queue
+} TCB_t;
+
+// intrusive doubly-linked list, O(1) insert at tail, pop head and remove
+typedef struct queue{
+	TCB_t *head;
+	TCB_t *tail;
+	uint32_t size;
+}queue_t;
+
+// wait queue ordered by priority, FIFO within a level: one list per level plus a bitmap
+// of the non-empty ones, so insert, remove and taking the highest waiter are all O(1).
+// Only the head of a level is stored and its prev points at the tail, 4 bytes a level
+// rather than a whole queue_t since every semaphore, mutex and event group carries one
+typedef struct waitq{
+	bitVector_t levels;
+	struct TCB *bucket[NUM_PRIORITIES];	// first waiter per level, NULL when empty
+	uint32_t size;
+}waitq_t;
+
+typedef struct sem {
+	int32_t s;
+	waitq_t wait;
+} sem_t;
+// event group: 32 flags, waiters ask for any or all of a mask and clear what they matched
+#define EVT_WAIT_ANY	0x00
+#define EVT_WAIT_ALL	0x01
+#define EVT_NO_CLEAR	0x02
+typedef struct event {
+	volatile uint32_t flags;
+	waitq_t wait;
+} event_t;
+
+typedef enum{
+	NOTIFY_SET_BITS = 0,		// value |= bits
+	NOTIFY_INCREMENT = 1,		// value++, a counting semaphore without the object with osThreadNotifyTake
+	NOTIFY_OVERWRITE = 2		// value = bits
+} notifyAction_t;
+
+// deferred log record, see oslog.h for the ids and main.c for the ring
+typedef struct logRecord {
+	volatile uint32_t seq;		// ring index + 1 once the writer has filled the record
+	uint8_t id;
+	uint8_t task;				// 0xFF before the kernel starts or from the drain
+	uint32_t time;				// msTicks
+	uint32_t arg[3];
+} logRecord_t;
+
+// fixed size message queue over a caller supplied ring of capacity * msgSize bytes
+typedef struct msgq {
+	uint8_t *buf;
+	uint32_t msgSize;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t head;				// slot the next receive reads
+	uint32_t tail;				// slot the next send writes
+	waitq_t senders;			// blocked on a full queue
+	waitq_t receivers;			// blocked on an empty queue
+} msgq_t;
+
+// fixed block pool, free blocks are linked through their first word
+typedef struct pool {
+	void *volatile freeList;
+	uint32_t blockSize;			// rounded up to whole words
+	uint32_t numBlocks;
+	volatile uint32_t used;
+	volatile uint32_t highWater;	// most blocks ever out at once
+	waitq_t wait;				// tasks blocked in alloc_pool on an empty pool
+} pool_t;
+
+typedef enum{
+	PRIO_INHERIT = 0,			// owner inherits the priority of its waiters, under SCHED_EDF also their deadline
+	PRIO_CEILING = 1			// owner runs at the static ceiling while it holds the mutex
+} mtxProtocol_t;
+
+typedef struct mutex{
+	TCB_t *volatile owner;		// NULL when free, claimed with LDREX/STREX on the fast path
+	waitq_t wait;
+	struct mutex *nextHeld;
+	bool linked;				// on the owner's heldMutexes, done lazily once a waiter or the ceiling needs it
+	mtxProtocol_t protocol;
+	priority_t ceiling;			// highest priority of any task that locks it, PRIO_CEILING only
+}mutex_t;
+
+#endif /* __TYPES_C */
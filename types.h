@@ -1,2 +1,24 @@
-typedef struct OS_TCB;
-
+/*
+ * Kernel interface for code built in its own translation unit (uart.c).
+ * main.c includes types.c directly and defines everything declared here.
+ */
+#ifndef __TYPES_H
+#define __TYPES_H
+
+#include "types.c"
+
+// false in ISRs, critical sections, the idle task and before the kernel starts,
+// where a driver has to poll instead of blocking
+bool osCanBlock(void);
+extern volatile uint32_t msTicks;
+
+void init_evt(event_t *evt);
+uint32_t set_evt(event_t *evt, uint32_t flags);
+uint32_t clear_evt(event_t *evt, uint32_t flags);
+osStatus_t wait_evt(event_t *evt, uint32_t mask, uint8_t options, uint32_t timeout, uint32_t *flags);
+
+void init_mtx(mutex_t *mtx);
+void acquire(mutex_t *mtx);
+void release(mutex_t *mtx);
+
+#endif /* end __TYPES_H */
@@ -20,165 +20,250 @@
 ****************************************************************************/
 #include "lpc17xx.h"
 //#include "type.h"
+#include "types.h"
 #include "uart.h"
+#include "uartbaud.h"
 
 //#ifdef __DBG_ITM
 volatile int ITM_RxBuffer = ITM_RXBUFFER_EMPTY;  /*  CMSIS Debug Input        */
 //#endif
 
 volatile uint32_t UART0Status, UART1Status;
-volatile uint8_t UART0TxEmpty = 1, UART1TxEmpty = 1;
-volatile uint8_t UART0Buffer[BUFSIZE], UART1Buffer[BUFSIZE];
-volatile uint32_t UART0Count = 0, UART1Count = 0;
-
-volatile uint8_t RcvLock0; 
-volatile uint8_t SndLock0; 
-
-volatile uint8_t RcvLock1; 
-volatile uint8_t SndLock1; 
 
 volatile int i = 0;
 
-void Free(volatile uint8_t *tbl){
-	*tbl = 0;
-}
+/* Transmit ring per port: writers copy into it, the THRE interrupt moves it into
+   the 16 byte hardware FIFO. Writers only wait when it is full. */
+#define TX_SPACE	0x01			/* event flag, set when a full ring gets room */
+
+typedef struct {
+	uint8_t buf[TXBUFSIZE];
+	volatile uint32_t head;			/* free running, written by the writers */
+	volatile uint32_t tail;			/* free running, moved into the FIFO */
+	volatile uint8_t active;		/* a THRE interrupt is still to come */
+	event_t space;
+} uartTx_t;
+
+/* Receive ring per port, filled by the RDA and CTI interrupts. A reader short of data
+   says how many bytes it still wants and the interrupt only wakes it once they are in
+   or the line goes idle (CTI), not on every byte. */
+#define RX_DATA		0x01			/* event flags: enough bytes for the reader */
+#define RX_IDLE		0x02			/* the line went quiet with data in the FIFO */
+
+typedef struct {
+	uint8_t buf[RXBUFSIZE];
+	volatile uint32_t head;			/* free running, written by the interrupt */
+	volatile uint32_t tail;			/* free running, read by UARTRead */
+	volatile uint32_t want;			/* bytes a reader still needs, 0 with no reader */
+	volatile uint32_t overflows;	/* bytes dropped on a full ring */
+	volatile uint32_t lineErrors;	/* overrun, parity, framing and break reports */
+	event_t data;
+} uartRx_t;
+
+/* Everything a port changes at run time, zeroed at startup */
+typedef struct {
+	uartTx_t tx;
+	uartRx_t rx;
+	uartBaud_t baud;
+	mutex_t sndMtx;					/* one writer at a time, tasks that can block only */
+} uartState_t;
+
+uartState_t uartState[UART_PORTS];
+
+/* Fixed description of a port. Adding one is an entry here, its IRQ handler below and
+   UART_PORTS in uart.h. */
+typedef struct {
+	LPC_UART_TypeDef *regs;
+	uartState_t *st;
+	IRQn_Type irq;
+	volatile uint32_t *pclksel;		/* PCLKSEL0 or PCLKSEL1 */
+	uint8_t pclkShift;				/* two bit PCLK divider field */
+	uint32_t pconp;					/* power control bit */
+	volatile uint32_t *pinsel;		/* TxD and RxD pin functions */
+	uint32_t pinMask;
+	uint32_t pinFunc;
+} uartPort_t;
+
+static const uartPort_t uartPort[UART_PORTS] = {
+	/* UART0: TxD0 P0.2, RxD0 P0.3 */
+	{ (LPC_UART_TypeDef *)LPC_UART0, &uartState[0], UART0_IRQn, &LPC_SC->PCLKSEL0, 6, 1UL << 3, &LPC_PINCON->PINSEL0, 0x000000F0, 0x00000050 },
+#if UART_PORTS > 1
+	/* UART1: TxD1 P2.0, RxD1 P2.1 */
+	{ (LPC_UART_TypeDef *)LPC_UART1, &uartState[1], UART1_IRQn, &LPC_SC->PCLKSEL0, 8, 1UL << 4, &LPC_PINCON->PINSEL4, 0x0000000F, 0x0000000A },
+#endif
+#if UART_PORTS > 2
+	/* UART2: TxD2 P0.10, RxD2 P0.11 */
+	{ (LPC_UART_TypeDef *)LPC_UART2, &uartState[2], UART2_IRQn, &LPC_SC->PCLKSEL1, 16, 1UL << 24, &LPC_PINCON->PINSEL0, 0x00F00000, 0x00500000 },
+#endif
+#if UART_PORTS > 3
+	/* UART3: TxD3 P0.0, RxD3 P0.1 */
+	{ (LPC_UART_TypeDef *)LPC_UART3, &uartState[3], UART3_IRQn, &LPC_SC->PCLKSEL1, 18, 1UL << 25, &LPC_PINCON->PINSEL0, 0x0000000F, 0x0000000A },
+#endif
+};
+
+static void uartRxIsr( LPC_UART_TypeDef *LPC_UART, uartRx_t *rx, uint8_t IIRValue )
+{
+	uint8_t LSRValue;
 
-uint8_t Lock(volatile uint8_t *tbl){
-	// Get the lock status and see if it is already locked
-	if (__LDREXW(tbl) == 0) {
-		// if not locked, try set lock to 1
-		return  (__STREXW(1, tbl) != 0) ;
-	} else {
-		return(1); // return fail status
+	/* Note: reading LSR clears a line status interrupt, reading RBR clears RDA and CTI */
+	while ( (LSRValue = LPC_UART->LSR) & LSR_RDR )
+	{
+		if ( LSRValue & (LSR_OE | LSR_PE | LSR_FE | LSR_BI) )
+			rx->lineErrors++;
+		if ( rx->head - rx->tail == RXBUFSIZE )
+		{
+			(void)LPC_UART->RBR;
+			rx->overflows++;
+			continue;
+		}
+		rx->buf[rx->head % RXBUFSIZE] = LPC_UART->RBR;
+		rx->head++;
 	}
-}
+	if ( LSRValue & (LSR_OE | LSR_PE | LSR_FE | LSR_BI) )
+		rx->lineErrors++;
 
-uint8_t LockRcv(uint8_t portNum){
-	if(portNum > 1)
-		return 0x1;
-	return Lock(portNum == 0? &RcvLock0 : &RcvLock1);
+	/* want is set before the reader leaves the critical section, so a reader that has not
+	   reached wait_evt yet still gets the flags and returns from it at once */
+	if ( rx->want != 0 )
+	{
+		if ( IIRValue == IIR_CTI )
+			set_evt( &rx->data, RX_DATA | RX_IDLE );
+		else if ( rx->head - rx->tail >= rx->want )
+			set_evt( &rx->data, RX_DATA );
+	}
 }
 
-uint8_t LockSnd(uint8_t portNum){
-	if(portNum > 1)
-		return 0x1;
-	return Lock(portNum == 0? &SndLock0 : &SndLock1);
-}
+/* Load up to a FIFO's worth from the ring, call with the THR FIFO empty and inside a
+   kernel critical section or the UART interrupt. Wakes writers waiting for room. */
+static void uartTxFill( LPC_UART_TypeDef *LPC_UART, uartTx_t *tx )
+{
+	uint32_t n;
+	uint8_t wasFull = (tx->head - tx->tail == TXBUFSIZE);
 
-void FreeRcv(uint8_t portNum){
-	if(portNum > 1)
-		return;
-	Free( portNum == 0? &RcvLock0 : &RcvLock1 );
-}
+	for ( n = 0; n < 16 && tx->tail != tx->head; n++ )
+	{
+		LPC_UART->THR = tx->buf[tx->tail % TXBUFSIZE];
+		tx->tail++;
+	}
+	tx->active = (n != 0);
 
-void FreeSnd(uint8_t portNum){
-	if(portNum > 1)
-		return;
-	Free( portNum == 0? &SndLock0 : &SndLock1 );
+	if ( n != 0 && (wasFull || tx->space.wait.size != 0) )
+		set_evt( &tx->space, TX_SPACE );
 }
 
+/* Copy into the ring, the time taken depends on the length and not the baud rate unless
+   the ring is full. Then a task waits for the interrupt to make room, anything that
+   cannot block (ISR, critical section, idle task, before the kernel starts) polls.
+   Tasks hold the port's writer mutex so one call's bytes go out together, a caller that
+   cannot block skips it and its bytes may land between another writer's. */
+static void uartTxPut( const uartPort_t *port, const uint8_t *data, uint32_t length )
+{
+	LPC_UART_TypeDef *LPC_UART = port->regs;
+	uartTx_t *tx = &port->st->tx;
+	uint32_t irq;
+	bool locked = osCanBlock();
+
+	if ( locked )
+		acquire( &port->st->sndMtx );
+	while ( length != 0 )
+	{
+		irq = osCriticalEnter();
+		while ( length != 0 && tx->head - tx->tail != TXBUFSIZE )
+		{
+			tx->buf[tx->head % TXBUFSIZE] = *data++;
+			tx->head++;
+			length--;
+		}
+		if ( !tx->active )
+			uartTxFill( LPC_UART, tx );
+		osCriticalExit(irq);
 
-/*****************************************************************************
-** Function name:		UART0_IRQHandler
-**
-** Descriptions:		UART0 interrupt handler
-**
-** parameters:			None
-** Returned value:		None
-** 
-*****************************************************************************/
-void UART0_IRQHandler (void) 
+		if ( length != 0 )
+		{
+			if ( locked )
+			{
+				wait_evt( &tx->space, TX_SPACE, EVT_WAIT_ANY, OS_WAIT_FOREVER, NULL );
+			}
+			else
+			{
+				while ( !(LPC_UART->LSR & LSR_THRE) );
+				irq = osCriticalEnter();
+				if ( LPC_UART->LSR & LSR_THRE )
+					uartTxFill( LPC_UART, tx );
+				osCriticalExit(irq);
+			}
+		}
+	}
+	if ( locked )
+		release( &port->st->sndMtx );
+}
+
+/* Interrupt body shared by all ports */
+static void uartIsr( const uartPort_t *port )
 {
-	uint8_t IIRValue, LSRValue;
+	uint8_t IIRValue;
 
-	IIRValue = LPC_UART0->IIR;
+	IIRValue = port->regs->IIR;
 
 	IIRValue >>= 1;			/* skip pending bit in IIR */
 	IIRValue &= 0x07;			/* check bit 1~3, interrupt identification */
 
-	LSRValue = LPC_UART0->LSR;
-
-	if ( LSRValue & LSR_RDR )	/* Receive Data Ready */	
+	if ( IIRValue == IIR_RDA || IIRValue == IIR_CTI || IIRValue == IIR_RLS )
 	{
-		/* If no error on RLS, normal ready, save into the data buffer. */
-		/* Note: read RBR will clear the interrupt */
-		UART0Buffer[UART0Count] = LPC_UART0->RBR;
-		UART0Count++;
-		if ( UART0Count == BUFSIZE )
-		{
-		UART0Count = 0;		/* buffer overflow */
-		}
+		uartRxIsr( port->regs, &port->st->rx, IIRValue );
 	}
 
 	if ( IIRValue == IIR_THRE )	/* THRE, transmit holding register empty */
 	{
-	/* THRE interrupt */
-		LSRValue = LPC_UART0->LSR;		/* Check status in the LSR to see if
-									valid data in U0THR or not */
-		if ( LSRValue & LSR_THRE ){
-			UART0TxEmpty = 1;
-		}
-		else{
-			UART0TxEmpty = 0;
-		}
+		/* THRE interrupt, reading IIR cleared it. Refill the FIFO from the ring */
+		uartTxFill( port->regs, &port->st->tx );
 	}
 
 }
 
 /*****************************************************************************
-** Function name:		UART1_IRQHandler
+** Function name:		UART0_IRQHandler .. UART3_IRQHandler
 **
-** Descriptions:		UART1 interrupt handler
+** Descriptions:		UART0 to UART3 interrupt handlers
 **
 ** parameters:			None
 ** Returned value:		None
 ** 
 *****************************************************************************/
-void UART1_IRQHandler (void) 
+void UART0_IRQHandler (void) 
 {
+	uartIsr( &uartPort[0] );
+}
 
-	uint8_t IIRValue, LSRValue;
-
-	IIRValue = LPC_UART1->IIR;
-
-	IIRValue >>= 1;			/* skip pending bit in IIR */
-	IIRValue &= 0x07;			/* check bit 1~3, interrupt identification */
-
-	LSRValue = LPC_UART1->LSR;
-
-	if ( LSRValue & LSR_RDR )	/* Receive Data Ready */	
-	{
-		/* If no error on RLS, normal ready, save into the data buffer. */
-		/* Note: read RBR will clear the interrupt */
-		UART1Buffer[UART1Count] = LPC_UART1->RBR;
-		UART1Count++;
-		if ( UART1Count == BUFSIZE ){
-		UART0Count = 0;		/* buffer overflow */
-		}
-	}
+#if UART_PORTS > 1
+void UART1_IRQHandler (void) 
+{
+	uartIsr( &uartPort[1] );
+}
+#endif
 
-	if ( IIRValue == IIR_THRE )	/* THRE, transmit holding register empty */
-	{
-	/* THRE interrupt */
-		LSRValue = LPC_UART1->LSR;		/* Check status in the LSR to see if
-									valid data in U0THR or not */
-		if ( LSRValue & LSR_THRE ){
-			UART1TxEmpty = 1;
-		}
-		else{
-			UART1TxEmpty = 0;
-		}
-	}
+#if UART_PORTS > 2
+void UART2_IRQHandler (void) 
+{
+	uartIsr( &uartPort[2] );
+}
+#endif
 
+#if UART_PORTS > 3
+void UART3_IRQHandler (void) 
+{
+	uartIsr( &uartPort[3] );
 }
+#endif
 
-/* By default, the PCLKSELx value is zero, thus, the PCLK for
-	all the peripherals is 1/4 of the SystemFrequency. */
-uint32_t getFrequency(uint32_t clk_slct){
+/* SystemInit sets PCLKSELx before PLL0 connects (errata PCLKSELx.1, a write after
+	that may not take), the UARTs run at CCLK/1 there. Returns the PCLK a two bit
+	PCLKSELx field value selects. */
+uint32_t getFrequency(uint32_t pclkSel){
 
 	uint32_t pclk;
 
-	switch ( (LPC_SC->PCLKSEL0 >> clk_slct) & 0x03 )
+	switch ( pclkSel & 0x03 )
 	{
 		case 0x00:
 		default:
@@ -198,78 +283,94 @@ uint32_t getFrequency(uint32_t clk_slct){
 	return pclk;
 }
 
+/* Pick the divisors that come closest to baudrate from the PCLK the port's field in
+   PCLKSEL0 or 1 selects. PCLKSEL is only read, SystemInit owns it. Only a result within
+   the 3% a UART link tolerates is programmed into the divisor latches and FDR, otherwise
+   nothing is touched and FALSE returned. */
+static uint32_t uartSetBaud( const uartPort_t *port, uint32_t baudrate )
+{
+	LPC_UART_TypeDef *LPC_UART = port->regs;
+	uartBaud_t *result = &port->st->baud;
+	uint32_t pclk = getFrequency( *port->pclksel >> port->pclkShift );
+
+	if ( uartBaudSearch( pclk, baudrate, result ) > 30000 )
+	{
+		result->baud = 0;
+		result->errorPpm = 0;
+		return (FALSE);
+	}
+
+	LPC_UART->LCR = 0x83;		/* 8 bits, no Parity, 1 Stop bit, The access to Divisor latches is enabled. */
+	LPC_UART->DLM = result->dl / 256;
+	LPC_UART->DLL = result->dl % 256;
+	LPC_UART->FDR = (result->mulVal << 4) | result->divAddVal;
+	LPC_UART->LCR = 0x03;		/* DLAB = 0 */
+
+	return (TRUE);
+}
+
+/*****************************************************************************
+** Function name:		UARTGetBaud
+**
+** Descriptions:		Baud rate UARTInit achieved on a port
+**
+** parameters:			portNum, error from the requested rate in ppm
+** Returned value:		achieved baud rate, 0 for a port not set up
+** 
+*****************************************************************************/
+uint32_t UARTGetBaud( uint32_t portNum, int32_t *errorPpm )
+{
+	if(portNum >= UART_PORTS)
+		return 0;
+	if ( errorPpm != NULL )
+		*errorPpm = uartState[portNum].baud.errorPpm;
+	return uartState[portNum].baud.baud;
+}
+
 /*****************************************************************************
 ** Function name:		UARTInit
 **
 ** Descriptions:		Initialize UART port, setup pin select,
 **						clock, parity, stop bits, FIFO, etc.
 **
-** parameters:			portNum(0 or 1) and UART baudrate
-** Returned value:		true or false, return false only if the 
-**						interrupt handler can't be installed to the 
-**						VIC table
+** parameters:			portNum(0 to UART_PORTS - 1) and UART baudrate
+** Returned value:		true or false, false for an unknown port or a
+**						baud rate no divisor gets within 3% of, which
+**						leaves the divisors as they were.
+**						See UARTGetBaud for the rate achieved
 ** 
 *****************************************************************************/
 uint32_t UARTInit( uint32_t PortNum, uint32_t baudrate )
 {
-	uint32_t Fdiv;
-	uint32_t  pclk;
-
-	if ( PortNum == 0 )
-	{
-		LPC_PINCON->PINSEL0 &= ~0x000000F0;
-		LPC_PINCON->PINSEL0 |= 0x00000050;  /* RxD0 is P0.3 and TxD0 is P0.2 */
-
-		/* Bit 6~7 is for UART0 */
-		pclk = getFrequency(6);
+	const uartPort_t *port;
+	uartState_t *st;
+	uint32_t ok;
 
-		LPC_UART0->LCR = 0x83;		/* 8 bits, no Parity, 1 Stop bit, The access to Divisor latches is enabled. */
+	if ( PortNum >= UART_PORTS )
+		return( FALSE );
+	port = &uartPort[PortNum];
+	st = port->st;
 
-		Fdiv = ( pclk / 16 ) / baudrate ;	/*baud rate */
-		LPC_UART0->DLM = Fdiv / 256;					
-		LPC_UART0->DLL = Fdiv % 256;
+	LPC_SC->PCONP |= port->pconp;		/* UART2 and UART3 are powered off after reset */
+	*port->pinsel &= ~port->pinMask;
+	*port->pinsel |= port->pinFunc;
 
-		LPC_UART0->LCR = 0x03;		/* DLAB = 0 */
-		LPC_UART0->FCR = 0x07;		/* Enable and reset TX and RX FIFO. */
-
-	 	NVIC_EnableIRQ(UART0_IRQn);
-
-		//LPC_UART0->IER = IER_RBR | IER_THRE | IER_RLS;	/* Enable UART0 interrupt */
-		//LPC_UART0->IER =  IER_THRE ;//| IER_RLS;			/* Disable RBR */
-
-		FreeRcv(0);
-		FreeSnd(0);
-		return (TRUE);
-	}
-	else if ( PortNum == 1 )
-	{
-		LPC_PINCON->PINSEL4 &= ~0x0000000F;
-		LPC_PINCON->PINSEL4 |= 0x0000000A;	/* Enable RxD1 P2.1, TxD1 P2.0 */
+	ok = uartSetBaud( port, baudrate );
 
-	/* By default, the PCLKSELx value is zero, thus, the PCLK for
-	all the peripherals is 1/4 of the SystemFrequency. */
-	/* Bit 8,9 are for UART1 */
-		pclk = getFrequency(8);
+	port->regs->FCR = 0x87;		/* Enable and reset TX and RX FIFO, RX trigger at 8 bytes. */
 
-		LPC_UART1->LCR = 0x83;		/* 8 bits, no Parity, 1 Stop bit */
+	NVIC_SetPriority(port->irq, MAX_SYSCALL_PRIORITY);	/* calls the kernel */
+	NVIC_EnableIRQ(port->irq);
 
-		Fdiv = ( pclk / 16 ) / baudrate ;	/*baud rate */
-		LPC_UART1->DLM = Fdiv / 256;					
-		LPC_UART1->DLL = Fdiv % 256;
+	init_evt( &st->tx.space );
+	st->tx.head = st->tx.tail = 0;
+	st->tx.active = 0;
+	init_evt( &st->rx.data );
+	st->rx.head = st->rx.tail = 0;
+	port->regs->IER = IER_THRE | IER_RBR | IER_RLS;	/* rings run off THRE, RDA and CTI */
 
-		LPC_UART1->LCR = 0x03;		/* DLAB = 0 */
-		LPC_UART1->FCR = 0x07;		/* Enable and reset TX and RX FIFO. */
-
-	 	NVIC_EnableIRQ(UART1_IRQn);
-
-		//LPC_UART1->IER = IER_RBR | IER_THRE | IER_RLS;	/* Enable UART1 interrupt */
-
-		FreeRcv(1);
-		FreeSnd(1);
-
-		return (TRUE);
-	}
-	return( FALSE ); 
+	init_mtx( &st->sndMtx );
+	return (ok);
 }
 
 /*****************************************************************************
@@ -285,48 +386,18 @@ uint32_t UARTInit( uint32_t PortNum, uint32_t baudrate )
 
 void UARTSend( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
 {
-	LPC_UART_TypeDef *LPC_UART;
-	volatile unsigned char *UARTTxEmpty;				//ASK Douglas
-	uint8_t *localBufferPtr;
-	uint32_t localLength;
-
-	if((portNum >> 1 ) != 0)
+	if(portNum >= UART_PORTS)
 		return;
 
-	localLength = Length;
-	localBufferPtr = BufferPtr;
-	UARTTxEmpty = (portNum == 0 ? &UART0TxEmpty : &UART1TxEmpty);
-	LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
-
-	//Enable interupt
-	LPC_UART->IER |=  IER_THRE;
-
-	while( LockSnd(portNum));
-
-	while ( localLength != 0 ){
-		/* THRE status, contain valid data */
-		while ( !(*UARTTxEmpty & 0x01) );
-		LPC_UART->THR = *localBufferPtr;
-		*UARTTxEmpty = 0;	/* not empty in the THR until it shifts out */
-		localBufferPtr++;
-		localLength--;
-	}
-
-	FreeSnd(portNum);
-
-	//Reanble other interpts
-	LPC_UART->IER &= ~IER_THRE;
-
-	return;
+	uartTxPut( &uartPort[portNum], BufferPtr, Length );
 }
 
 void UARTSendChar( uint32_t portNum, uint8_t character)
 {
 	#ifdef __RTGT_UART
-		LPC_UART_TypeDef *LPC_UART;
-		LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
-		while (!(LPC_UART->LSR & 0x20));
-		LPC_UART->THR = character;
+		if(portNum >= UART_PORTS)
+			return;
+		uartTxPut( &uartPort[portNum], &character, 1 );
 	#else
 		ITM_SendChar(character);
 	#endif
@@ -335,71 +406,139 @@ void UARTSendChar( uint32_t portNum, uint8_t character)
 
 
 /*****************************************************************************
-** Function name:		UARTRecieve
+** Function name:		UARTRead
 **
-** Descriptions:		Recieve a block of data to the UART 0-1 port based
-**						on the data length
+** Descriptions:		Read from a UART receive ring. Waits, parked in the
+**						kernel, until length bytes are in, the line goes idle
+**						after some data, or timeout ticks pass. Where the caller
+**						cannot block (see osCanBlock) it takes what is there.
 **
-** parameters:			portNum, buffer pointer, and data length
-** Returned value:		integer showing status
+** parameters:			portNum, buffer pointer, length and timeout in ticks
+** Returned value:		number of bytes read
 ** 
 *****************************************************************************/
-uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
+uint32_t UARTRead( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length, uint32_t timeout )
 {
+	uartRx_t *rx;
+	uint32_t rcvd_len = 0;
+	uint32_t deadline = msTicks + timeout;
+	uint32_t flags, irq;
 
-	LPC_UART_TypeDef *LPC_UART;
-	volatile uint32_t *UARTCount;				//ASK Douglas
-	volatile uint8_t *UARTBuffer;
-	uint8_t *rcvdBufferPtr;
-	uint32_t rcvd_len, i;
-
-	if((portNum >> 1 ) != 0)
+	if(portNum >= UART_PORTS)
 		return 0;
+	rx = &uartState[portNum].rx;
 
-	rcvd_len = 0x0;
-	rcvdBufferPtr = BufferPtr;
-	UARTCount = (portNum == 0 ? &UART0Count : &UART1Count);
-	UARTBuffer = (portNum == 0 ? UART0Buffer : UART1Buffer);
-	LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
-
-	*UARTCount = 0x0;
-
-	//Enable interupt
-	LPC_UART->IER |=  IER_RBR;
-
-	//busy waiting
-
-	while( *UARTCount == 0 );
-
-
-	//This part has to be put in the critical section
-	while(LockRcv(portNum));
-
-	//Reanble other interpts
-	LPC_UART->IER &= ~IER_RBR;			/* Disable RBR */
+	while ( 1 )
+	{
+		irq = osCriticalEnter();
+		while ( rcvd_len < Length && rx->tail != rx->head )
+		{
+			BufferPtr[rcvd_len++] = rx->buf[rx->tail % RXBUFSIZE];
+			rx->tail++;
+		}
+		if ( rcvd_len == Length || timeout == 0 || !osCanBlock() )
+		{
+			rx->want = 0;
+			osCriticalExit(irq);
+			return rcvd_len;
+		}
+		/* stale flags go while the interrupt is masked, once want is set it raises them again */
+		clear_evt( &rx->data, RX_DATA | RX_IDLE );
+		rx->want = (Length - rcvd_len < RXBUFSIZE / 2) ? Length - rcvd_len : RXBUFSIZE / 2;
+		osCriticalExit(irq);
 
+		if ( timeout != OS_WAIT_FOREVER )
+		{
+			if ( (int32_t)(deadline - msTicks) <= 0 )
+			{
+				timeout = 0;			/* one last pass, it also drops want */
+				continue;
+			}
+			if ( wait_evt( &rx->data, RX_DATA | RX_IDLE, EVT_WAIT_ANY, deadline - msTicks, &flags ) != OS_OK )
+				timeout = 0;			/* one last pass picks up what came in */
+		}
+		else
+		{
+			wait_evt( &rx->data, RX_DATA | RX_IDLE, EVT_WAIT_ANY, OS_WAIT_FOREVER, &flags );
+		}
+		if ( timeout != 0 && (flags & RX_IDLE) && rx->tail != rx->head )
+			timeout = 0;				/* idle line, return what there is */
+	}
+}
 
-	for(i = 0; i < *UARTCount; ++i)
-		rcvdBufferPtr[rcvd_len++] = UARTBuffer[i];
+/* Wait for one byte. A task parks on the ring, anything that cannot block (ISR, critical
+   section, idle task) may have the RX interrupt masked, so it polls the receiver and drains
+   it the way the interrupt would, as uartTxPut polls THRE */
+static uint8_t uartRxWait( const uartPort_t *port, uint32_t portNum )
+{
+	uint8_t ret;
+	uint32_t irq;
 
-	*UARTCount = 0;
+	if ( osCanBlock() )
+	{
+		while ( UARTRead( portNum, &ret, 1, OS_WAIT_FOREVER ) == 0 );
+		return ret;
+	}
+	while ( UARTRead( portNum, &ret, 1, 0 ) == 0 )
+	{
+		while ( !(port->regs->LSR & LSR_RDR) );
+		irq = osCriticalEnter();
+		uartRxIsr( port->regs, &port->st->rx, IIR_RDA );
+		osCriticalExit(irq);
+	}
+	return ret;
+}
 
-	FreeRcv(portNum);
+/*****************************************************************************
+** Function name:		UARTRecieve
+**
+** Descriptions:		Recieve a block of data to the UART port based
+**						on the data length. Waits for the first byte, a
+**						caller that cannot block polls the receiver.
+**
+** parameters:			portNum, buffer pointer, and data length
+** Returned value:		integer showing status
+** 
+*****************************************************************************/
+uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
+{
+	uint32_t rcvd_len;
 
+	if(portNum >= UART_PORTS)
+		return 0;
+	/* whatever has arrived, waiting for the first byte */
+	rcvd_len = UARTRead( portNum, BufferPtr, Length, 0 );
+	if ( rcvd_len == 0 && Length != 0 )
+	{
+		BufferPtr[0] = uartRxWait( &uartPort[portNum], portNum );
+		rcvd_len = 1 + UARTRead( portNum, BufferPtr + 1, Length - 1, 0 );
+	}
 	return rcvd_len;
 }
 
+/*****************************************************************************
+** Function name:		UARTRxErrors
+**
+** Descriptions:		Receive error counts since UARTInit
+**
+** parameters:			portNum, bytes dropped on a full ring, line errors
+** Returned value:		None
+** 
+*****************************************************************************/
+void UARTRxErrors( uint32_t portNum, uint32_t *overflows, uint32_t *lineErrors )
+{
+	if(portNum >= UART_PORTS)
+		return;
+	*overflows = uartState[portNum].rx.overflows;
+	*lineErrors = uartState[portNum].rx.lineErrors;
+}
+
 uint8_t UARTReceiveChar( uint32_t portNum)
 {
 	#ifdef __RTGT_UART
-		/*uint8_t ret[1];
-		if (UARTRecieve(portNum, ret, 1) == 1)
-			return ret[0];
-		return 0x0;	*/
-		LPC_UART_TypeDef *LPC_UART;
-		LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
-		while (!(LPC_UART->LSR & 0x01));
-		return (LPC_UART->RBR);
+		if(portNum >= UART_PORTS)
+			return 0;
+		return uartRxWait( &uartPort[portNum], portNum );
 	#else
 		while (ITM_CheckChar() != 1) __NOP();
 		return (ITM_ReceiveChar());
@@ -1,69 +1,81 @@
-/****************************************************************************
- *   $Id:: uart.h 5751 2010-11-30 23:56:11Z usb00423                        $
- *   Project: NXP LPC17xx UART example
- *
- *   Description:
- *     This file contains UART code header definition.
- *
- ****************************************************************************
- * Software that is described herein is for illustrative purposes only
- * which provides customers with programming information regarding the
- * products. This software is supplied "AS IS" without any warranties.
- * NXP Semiconductors assumes no responsibility or liability for the
- * use of the software, conveys no license or title under any patent,
- * copyright, or mask work right to the product. NXP Semiconductors
- * reserves the right to make changes in the software without
- * notification. NXP Semiconductors also make no representation or
- * warranty that such application will be suitable for the specified
- * use without further testing or modification.
-****************************************************************************/
-#ifndef __UART_H 
-#define __UART_H
-
-#include <stdint.h>
-
-#define IER_RBR		0x01
-#define IER_THRE	0x02
-#define IER_RLS		0x04
-
-#define IIR_PEND	0x01
-#define IIR_RLS		0x03
-#define IIR_RDA		0x02
-#define IIR_CTI		0x06
-#define IIR_THRE	0x01
-
-#define LSR_RDR		0x01
-#define LSR_OE		0x02
-#define LSR_PE		0x04
-#define LSR_FE		0x08
-#define LSR_BI		0x10
-#define LSR_THRE	0x20
-#define LSR_TEMT	0x40
-#define LSR_RXFE	0x80
-
-#define BUFSIZE		0x40
-
-#ifndef FALSE
-#define FALSE   (0)
-#endif
-
-#ifndef TRUE
-#define TRUE    (1)
-#endif
-
-
-void UART0_IRQHandler( void );
-void UART1_IRQHandler( void );
-
-uint32_t UARTInit( uint32_t portNum, uint32_t Baudrate );
-
-void     UARTSend(    uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
-uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
-
-void     UARTSendChar(    uint32_t portNum, uint8_t character );
-uint8_t  UARTReceiveChar( uint32_t portNum );
-
-#endif /* end __UART_H */
-/*****************************************************************************
-**                            End Of File
-******************************************************************************/
+/****************************************************************************
+ *   $Id:: uart.h 5751 2010-11-30 23:56:11Z usb00423                        $
+ *   Project: NXP LPC17xx UART example
+ *
+ *   Description:
+ *     This file contains UART code header definition.
+ *
+ ****************************************************************************
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * products. This software is supplied "AS IS" without any warranties.
+ * NXP Semiconductors assumes no responsibility or liability for the
+ * use of the software, conveys no license or title under any patent,
+ * copyright, or mask work right to the product. NXP Semiconductors
+ * reserves the right to make changes in the software without
+ * notification. NXP Semiconductors also make no representation or
+ * warranty that such application will be suitable for the specified
+ * use without further testing or modification.
+****************************************************************************/
+#ifndef __UART_H 
+#define __UART_H
+
+#include <stdint.h>
+
+#define IER_RBR		0x01
+#define IER_THRE	0x02
+#define IER_RLS		0x04
+
+#define IIR_PEND	0x01
+#define IIR_RLS		0x03
+#define IIR_RDA		0x02
+#define IIR_CTI		0x06
+#define IIR_THRE	0x01
+
+#define LSR_RDR		0x01
+#define LSR_OE		0x02
+#define LSR_PE		0x04
+#define LSR_FE		0x08
+#define LSR_BI		0x10
+#define LSR_THRE	0x20
+#define LSR_TEMT	0x40
+#define LSR_RXFE	0x80
+
+#define TXBUFSIZE	0x100		/* transmit ring per port, a power of two */
+#define RXBUFSIZE	0x100		/* receive ring per port, a power of two */
+
+/* UARTs driven, UART0 up to UART(UART_PORTS - 1). Each one costs its two rings and two
+   event groups in RAM (about 1.3 KB at NUM_PRIORITIES 32), so only the stdout port by default */
+#ifndef UART_PORTS
+#define UART_PORTS	1
+#endif
+
+#ifndef FALSE
+#define FALSE   (0)
+#endif
+
+#ifndef TRUE
+#define TRUE    (1)
+#endif
+
+
+void UART0_IRQHandler( void );
+void UART1_IRQHandler( void );
+void UART2_IRQHandler( void );
+void UART3_IRQHandler( void );
+
+uint32_t UARTInit( uint32_t portNum, uint32_t Baudrate );
+uint32_t UARTGetBaud( uint32_t portNum, int32_t *errorPpm );
+
+void     UARTSend(    uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
+uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
+uint32_t UARTRead(    uint32_t portNum, uint8_t *BufferPtr, uint32_t Length, uint32_t timeout );
+void     UARTRxErrors( uint32_t portNum, uint32_t *overflows, uint32_t *lineErrors );
+
+void     UARTSendChar(    uint32_t portNum, uint8_t character );
+uint8_t  UARTReceiveChar( uint32_t portNum );
+
+#endif /* end __UART_H */
+/*****************************************************************************
+**                            End Of File
+******************************************************************************/
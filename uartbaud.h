@@ -0,0 +1,60 @@
+/*
+ * Fractional baud rate divider search for the LPC17xx UARTs, used by uart.c.
+ * Pure arithmetic with no register access, so tools/baudtest.c builds it on
+ * the host and checks it against the user manual.
+ */
+#ifndef __UARTBAUD_H
+#define __UARTBAUD_H
+
+#include <stdint.h>
+
+/* Achieved rate, the divisors and the error in ppm, kept per port after UARTInit */
+typedef struct {
+	uint32_t baud;
+	int32_t errorPpm;
+	uint16_t dl;
+	uint8_t divAddVal;
+	uint8_t mulVal;
+} uartBaud_t;
+
+/* Best DL, DIVADDVAL and MULVAL for baudrate from pclk, per the user manual:
+	baud = pclk / (16 * DL * (1 + DIVADDVAL / MULVAL))
+   with 1 <= MULVAL <= 15, 0 <= DIVADDVAL < MULVAL and DL >= 3 while the fractional
+   divider is in use. Returns the absolute error in ppm, 0xFFFFFFFF if nothing fits. */
+static uint32_t uartBaudSearch( uint32_t pclk, uint32_t baudrate, uartBaud_t *best )
+{
+	uint32_t bestErr = 0xFFFFFFFF;
+	uint32_t mul, divAdd;
+
+	for ( mul = 1; mul <= 15; mul++ )
+	{
+		for ( divAdd = 0; divAdd < mul; divAdd++ )
+		{
+			/* DL rounded to nearest: pclk * mul / (16 * baud * (mul + divAdd)) */
+			uint64_t den = 16ull * baudrate * (mul + divAdd);
+			uint64_t dl = ((uint64_t)pclk * mul + den / 2) / den;
+			uint64_t num, div, wanted;
+			uint32_t err;
+
+			if ( dl < (divAdd != 0 ? 3 : 1) || dl > 0xFFFF )
+				continue;
+			/* achieved = num / div, error = |num - wanted| / wanted with wanted = baud * div */
+			num = (uint64_t)pclk * mul;
+			div = 16 * dl * (mul + divAdd);
+			wanted = (uint64_t)baudrate * div;
+			err = (uint32_t)(((num > wanted ? num - wanted : wanted - num) * 1000000ull + wanted / 2) / wanted);
+			if ( err < bestErr )
+			{
+				bestErr = err;
+				best->baud = (uint32_t)((num + div / 2) / div);
+				best->errorPpm = (num >= wanted) ? (int32_t)err : -(int32_t)err;
+				best->dl = (uint16_t)dl;
+				best->divAddVal = divAdd;
+				best->mulVal = mul;
+			}
+		}
+	}
+	return bestErr;
+}
+
+#endif /* end __UARTBAUD_H */